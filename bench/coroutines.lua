@@ -0,0 +1,36 @@
+-- Resume/yield round trips, the case made cheaper by returning from
+-- yields instead of long-jumping (see 'nCyield' in ecierthon_resume).
+-- Run it with builds from before and after that change:
+--   make linux && ./ecierthon bench/coroutines.lua
+-- It times a ping-pong between the main thread and a coroutine through
+-- coroutine.wrap, a generator used as a for iterator, and plain
+-- coroutine.resume calls.
+
+local N = 5000000
+local yield = coroutine.yield
+
+local co = coroutine.wrap(function ()
+  local i = 0
+  while true do i = yield(i) + 1 end
+end)
+local t0 = os.clock()
+local x = 0
+for i = 1, N do x = co(x) end
+local t1 = os.clock()
+assert(x == N - 1)
+
+local function gen (n)
+  return coroutine.wrap(function () for i = 1, n do yield(i) end end)
+end
+local s = 0
+for v in gen(N) do s = s + v end
+local t2 = os.clock()
+assert(s == N * (N + 1) // 2)
+
+local co2 = coroutine.create(function (a) while true do a = yield(a) end end)
+local resume = coroutine.resume
+for i = 1, N do resume(co2, i) end
+local t3 = os.clock()
+
+print(string.format("ping-pong %.2f  generator %.2f  resume %.2f",
+  t1-t0, t2-t1, t3-t2))
@@ -0,0 +1,22 @@
+-- Event queue: closures, upvalue state and module tables, in the style
+-- of an event loop (part of the corpus measured by bench/pairs.lua).
+
+local M = {handlers = {}, stats = {n = 0, sum = 0}}
+local queue, head, tail = {}, 1, 0
+local function push(ev) tail = tail + 1; queue[tail] = ev end
+local function pop() if head > tail then return nil end local ev = queue[head]; queue[head] = nil; head = head + 1; return ev end
+function M.on(name, f) M.handlers[name] = f end
+function M.emit(name, v) push({name = name, value = v}) end
+M.on("add", function(v) M.stats.n = M.stats.n + 1; M.stats.sum = M.stats.sum + v end)
+M.on("double", function(v) M.emit("add", v * 2) end)
+M.on("noop", function() end)
+for i = 1, 500000 do
+  M.emit(i % 3 == 0 and "double" or (i % 3 == 1 and "add" or "noop"), i)
+  local ev = pop()
+  while ev do
+    local h = M.handlers[ev.name]
+    if h then h(ev.value) end
+    ev = pop()
+  end
+end
+print(M.stats.n, M.stats.sum)
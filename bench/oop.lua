@@ -0,0 +1,28 @@
+-- Objects: method calls through metatables, small constructors and
+-- field updates (part of the corpus measured by bench/pairs.lua).
+
+local Point = {}
+Point.__index = Point
+function Point.new(x, y) return setmetatable({x = x, y = y}, Point) end
+function Point:add(o) return Point.new(self.x + o.x, self.y + o.y) end
+function Point:len2() return self.x * self.x + self.y * self.y end
+local Account = {}
+Account.__index = Account
+function Account.new(b) return setmetatable({balance = b, log = {}}, Account) end
+function Account:deposit(v) self.balance = self.balance + v; self.log[#self.log + 1] = v end
+function Account:withdraw(v)
+  if v > self.balance then return false end
+  self.balance = self.balance - v
+  return true
+end
+local acc = Account.new(0)
+local p = Point.new(0, 0)
+local s = 0
+for i = 1, 2000000 do
+  p = p:add(Point.new(1, i % 3))
+  s = s + p:len2() % 7
+  acc:deposit(i % 10)
+  if i % 3 == 0 then acc:withdraw(5) end
+  if #acc.log > 1000 then acc.log = {} end
+end
+print(s, acc.balance)
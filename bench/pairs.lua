@@ -0,0 +1,51 @@
+-- Opcode and opcode-pair profile of the benchmark corpus in this
+-- directory, the table behind the choice of superinstructions (see
+-- OP_MOVE2 in lopcodes.h). Counting needs a profiling build:
+--   make clean && make linux MYCFLAGS=-DecierthonI_OPPROFILE &&
+--     ./ecierthon bench/pairs.lua
+-- Each benchmark counts for the same weight: a share is the average over
+-- the corpus of its share of the instructions run by each benchmark.
+-- (Any one benchmark can also be profiled alone with 'ecierthon -P'.)
+-- The fused pairs appear with their superinstruction as first opcode;
+-- to see the pairs as they were before fusion, profile a build of the
+-- tree from before superinstructions were added.
+
+local dir = arg and arg[0] and arg[0]:match("^(.*[/\\])") or ""
+local corpus = {"binarytrees.lua", "nbody.lua", "spectralnorm.lua",
+                "oop.lua", "eventqueue.lua", "strings.lua"}
+local NOPS, NPAIRS = 25, 40  -- number of opcodes and pairs printed
+
+assert(collectgarbage("opcounts"), "this build does not count opcodes")
+
+local opshare, pairshare = {}, {}
+local realwrite, realprint = io.write, print
+io.write, print = function () end, function () end  -- silence benchmarks
+for _, name in ipairs(corpus) do
+  collectgarbage("opprofile", "reset")
+  collectgarbage("opprofile", "start")
+  dofile(dir .. name)
+  collectgarbage("opprofile", "stop")
+  local counts = collectgarbage("opcounts")
+  local total = 0
+  for k, v in pairs(counts) do
+    if not k:find(" ") then total = total + v end
+  end
+  for k, v in pairs(counts) do
+    local t = k:find(" ") and pairshare or opshare
+    t[k] = (t[k] or 0) + v / total / #corpus
+  end
+end
+io.write, print = realwrite, realprint
+
+local function top (t, n)
+  local keys = {}
+  for k in pairs(t) do keys[#keys + 1] = k end
+  table.sort(keys, function (a, b) return t[a] > t[b] end)
+  for i = 1, math.min(n, #keys) do
+    print(string.format("%6.2f%%  %s", 100 * t[keys[i]], keys[i]))
+  end
+end
+print("opcodes")
+top(opshare, NOPS)
+print("opcode pairs")
+top(pairshare, NPAIRS)
@@ -0,0 +1,33 @@
+-- Compares protected calls in the C build (errors use _setjmp/_longjmp)
+-- and in the C++ build (errors are exceptions). Build the interpreter
+-- both ways and run this script with each one:
+--   make clean && make linux && ./ecierthon bench/pcall.lua
+--   make clean && make cpp && ./ecierthon bench/pcall.lua
+-- It times pcalls that return normally, pcalls that catch an error (a
+-- tenth as many), and, as controls that use no protected calls,
+-- recursive calls and '__index' metamethod calls.
+
+local N = 10000000
+
+local f = function (x) return x + 1 end
+local t0 = os.clock()
+for i = 1, N do pcall(f, i) end
+local t1 = os.clock()
+
+local g = function (x) error(x, 0) end
+for i = 1, N // 10 do pcall(g, i) end
+local t2 = os.clock()
+
+local function fib (n)
+  if n < 2 then return n end
+  return fib(n-1) + fib(n-2)
+end
+fib(30)
+local t3 = os.clock()
+
+local tt = setmetatable({}, {__index = function (t, k) return k end})
+for i = 1, N do local _ = tt[i] end
+local t4 = os.clock()
+
+print(string.format("pcall %.2f  pcall+error %.2f  fib %.3f  __index %.2f",
+  t1-t0, t2-t1, t3-t2, t4-t3))
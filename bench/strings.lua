@@ -0,0 +1,20 @@
+-- String building: pattern matching, formatting, counting and
+-- concatenation (part of the corpus measured by bench/pairs.lua).
+
+local words = {}
+for w in ("the quick brown fox jumps over the lazy dog again and again"):gmatch("%a+") do words[#words + 1] = w end
+local count = {}
+local buf = {}
+for i = 1, 300000 do
+  local w = words[i % #words + 1]
+  count[w] = (count[w] or 0) + 1
+  if i % 100 == 0 then
+    buf[#buf + 1] = string.format("%s:%d", w:upper(), count[w])
+  end
+  local n = #w
+  if n > 3 and w:sub(1, 1) == "a" then count.a = (count.a or 0) + 1 end
+end
+local keys = {}
+for k in pairs(count) do keys[#keys + 1] = k end
+table.sort(keys, function(a, b) return count[a] > count[b] end)
+print(#buf, keys[1], table.concat(buf, ","):len())
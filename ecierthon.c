@@ -38,11 +38,10 @@ static const char *progname = ecierthon_PROGNAME;
 
 
 /*
-** Hook set by signal function to stop the interpreter.
+** Interrupt function to stop the interpreter.
 */
-static void lstop (ecierthon_State *L, ecierthon_Debug *ar) {
-  (void)ar;  /* unused arg. */
-  ecierthon_sethook(L, NULL, 0, 0);  /* reset hook */
+static void lstop (ecierthon_State *L, int code) {
+  (void)code;  /* unused arg. */
   ecierthonL_error(L, "interrupted!");
 }
 
@@ -50,13 +49,12 @@ static void lstop (ecierthon_State *L, ecierthon_Debug *ar) {
 /*
 ** Function to be called at a C signal. Because a C signal cannot
 ** just change a ecierthon state (as there is no proper synchronization),
-** this function only sets a hook that, when called, will stop the
-** interpreter.
+** this function only posts an interrupt that, when the running code
+** reaches a safepoint, will stop the interpreter.
 */
 static void laction (int i) {
-  int flag = ecierthon_MASKCALL | ecierthon_MASKRET | ecierthon_MASKLINE | ecierthon_MASKCOUNT;
   signal(i, SIG_DFL); /* if another SIGINT happens, terminate process */
-  ecierthon_sethook(globalL, lstop, flag, 1);
+  ecierthon_interrupt(globalL, i);
 }
 
 
@@ -74,6 +72,7 @@ static void print_usage (const char *badoption) {
   "  -l name  require library 'name' into global 'name'\n"
   "  -v       show version information\n"
   "  -E       ignore environment variables\n"
+  "  -P       print opcode and opcode-pair counts at exit\n"
   "  -W       turn warnings on\n"
   "  --       stop handling options\n"
   "  -        stop handling options and execute stdin\n"
@@ -135,6 +134,7 @@ static int docall (ecierthon_State *L, int narg, int nres) {
   ecierthon_pushcfunction(L, msghandler);  /* push message handler */
   ecierthon_insert(L, base);  /* put it under function and args */
   globalL = L;  /* to be available to 'laction' */
+  ecierthon_setinterrupt(L, lstop);
   signal(SIGINT, laction);  /* set C-signal handler */
   status = ecierthon_pcall(L, narg, nres, base);
   signal(SIGINT, SIG_DFL); /* reset C-signal handler */
@@ -237,6 +237,7 @@ static int handle_script (ecierthon_State *L, char **argv) {
 #define has_v		4	/* -v */
 #define has_e		8	/* -e */
 #define has_E		16	/* -E */
+#define has_P		32	/* -P */
 
 
 /*
@@ -265,6 +266,11 @@ static int collectargs (char **argv, int *first) {
           return has_error;  /* invalid option */
         args |= has_E;
         break;
+      case 'P':
+        if (argv[i][2] != '\0')  /* extra characters? */
+          return has_error;  /* invalid option */
+        args |= has_P;
+        break;
       case 'W':
         if (argv[i][2] != '\0')  /* extra characters? */
           return has_error;  /* invalid option */
@@ -325,6 +331,63 @@ static int runargs (ecierthon_State *L, char **argv, int n) {
 }
 
 
+/*
+** Option '-P': the opcode profiler runs for the whole program, and
+** 'print_opcounts' prints its counts at exit, most frequent first.
+*/
+static int opprofiling = 0;
+
+#define NPAIRSHOWN	40  /* number of opcode pairs printed */
+
+typedef struct OpCount {
+  size_t count;
+  int op1, op2;  /* opcode, or pair of opcodes */
+} OpCount;
+
+
+static int cmpopcounts (const void *a, const void *b) {
+  size_t ca = ((const OpCount *)a)->count;
+  size_t cb = ((const OpCount *)b)->count;
+  return (ca < cb) - (ca > cb);  /* decreasing order */
+}
+
+
+static void print_opcounts (ecierthon_State *L) {
+  int nops, i, j, n;
+  double total = 0;
+  OpCount *c;
+  for (nops = 0; ecierthon_opname(L, nops) != NULL; nops++) ;
+  c = (OpCount *)malloc(sizeof(OpCount) * nops * nops);
+  if (c == NULL) return;
+  for (n = 0, i = 0; i < nops; i++) {
+    c[n].count = ecierthon_opcount(L, i, -1);
+    c[n].op1 = i;
+    total += (double)c[n].count;
+    if (c[n].count > 0) n++;
+  }
+  qsort(c, n, sizeof(OpCount), cmpopcounts);
+  fprintf(stderr, "opcode profile: %.0f instructions\n", total);
+  for (i = 0; i < n; i++)
+    fprintf(stderr, "%14.0f %6.2f%%  %s\n", (double)c[i].count,
+                    100.0 * (double)c[i].count / total, ecierthon_opname(L, c[i].op1));
+  for (n = 0, i = 0; i < nops; i++) {
+    for (j = 0; j < nops; j++) {
+      c[n].count = ecierthon_opcount(L, i, j);
+      c[n].op1 = i; c[n].op2 = j;
+      if (c[n].count > 0) n++;
+    }
+  }
+  qsort(c, n, sizeof(OpCount), cmpopcounts);
+  fprintf(stderr, "most frequent opcode pairs:\n");
+  for (i = 0; i < n && i < NPAIRSHOWN; i++)
+    fprintf(stderr, "%14.0f %6.2f%%  %s %s\n", (double)c[i].count,
+                    100.0 * (double)c[i].count / total,
+                    ecierthon_opname(L, c[i].op1), ecierthon_opname(L, c[i].op2));
+  fflush(stderr);
+  free(c);
+}
+
+
 static int handle_ecierthoninit (ecierthon_State *L) {
   const char *name = "=" ecierthon_INITVARVERSION;
   const char *init = getenv(name + 1);
@@ -597,6 +660,11 @@ static int pmain (ecierthon_State *L) {
   ecierthonL_openlibs(L);  /* open standard libraries */
   createargtable(L, argv, argc, script);  /* create table 'arg' */
   ecierthon_gc(L, ecierthon_GCGEN, 0, 0);  /* GC in generational mode */
+  if (args & has_P) {  /* option '-P'? */
+    opprofiling = (ecierthon_opprofile(L, ecierthon_OPPSTART) >= 0);
+    if (!opprofiling)
+      l_message(progname, "opcode profiler not available in this build");
+  }
   if (!(args & has_E)) {  /* no option '-E'? */
     if (handle_ecierthoninit(L) != ecierthon_OK)  /* run ecierthon_INIT */
       return 0;  /* error running ecierthon_INIT */
@@ -633,6 +701,8 @@ int main (int argc, char **argv) {
   status = ecierthon_pcall(L, 2, 1, 0);  /* do the call */
   result = ecierthon_toboolean(L, -1);  /* get result */
   report(L, status);
+  if (opprofiling)
+    print_opcounts(L);
   ecierthon_close(L);
   return (result && status == ecierthon_OK) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
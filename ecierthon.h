@@ -288,6 +288,15 @@ ecierthon_API int   (ecierthon_load) (ecierthon_State *L, ecierthon_Reader reade
 
 ecierthon_API int (ecierthon_dump) (ecierthon_State *L, ecierthon_Writer writer, void *data, int strip);
 
+/*
+** functions shared by several states
+*/
+typedef struct ecierthon_Shared ecierthon_Shared;
+
+ecierthon_API ecierthon_Shared *(ecierthon_share) (ecierthon_State *L, int idx);
+ecierthon_API int   (ecierthon_loadshared) (ecierthon_State *L, ecierthon_Shared *s);
+ecierthon_API void  (ecierthon_unshare) (ecierthon_Shared *s);
+
 
 /*
 ** coroutine functions
@@ -324,8 +333,73 @@ ecierthon_API void (ecierthon_warning)  (ecierthon_State *L, const char *msg, in
 #define ecierthon_GCISRUNNING		9
 #define ecierthon_GCGEN		10
 #define ecierthon_GCINC		11
+#define ecierthon_GCSTEPTIME		12
+#define ecierthon_GCADAPTIVE		13
+#define ecierthon_GCPRETENURE		14
 
 ecierthon_API int (ecierthon_gc) (ecierthon_State *L, int what, ...);
+ecierthon_API void (ecierthon_gcadjust) (ecierthon_State *L, ptrdiff_t delta);
+ecierthon_API size_t (ecierthon_setexternalsize) (ecierthon_State *L, int idx, size_t size);
+ecierthon_API size_t (ecierthon_resourceepoch) (ecierthon_State *L);
+
+
+/*
+** thread pool: 'ecierthon_newthread' reuses threads found dead by the
+** collector and threads given back with 'ecierthon_releasethread'.
+** The caller of 'ecierthon_releasethread' must hold the only reference
+** to the thread, as the same object is handed out again as a new
+** thread: no value in the state may refer to it except the caller's
+** own anchor (e.g., on its stack), which it must keep during the call
+** and drop right after it.
+*/
+
+typedef struct ecierthon_PoolStats {
+  size_t count;  /* threads currently in the pool */
+  size_t limit;  /* maximum number of pooled threads */
+  size_t reused;  /* threads handed out from the pool */
+  size_t created;  /* threads created anew */
+  size_t dropped;  /* released threads that did not fit in the pool */
+  size_t collected;  /* dead threads recycled by the collector */
+} ecierthon_PoolStats;
+
+ecierthon_API int (ecierthon_releasethread) (ecierthon_State *L, ecierthon_State *co);
+ecierthon_API int (ecierthon_setpoollimit) (ecierthon_State *L, int limit);
+ecierthon_API void (ecierthon_poolstats) (ecierthon_State *L, ecierthon_PoolStats *s);
+
+
+/*
+** heap inspection
+*/
+
+/* object types counted: basic types plus upvalues and prototypes */
+#define ecierthon_CENSUSTYPES		(ecierthon_NUMTYPES + 2)
+
+/* table size buckets (bucket 'b' holds tables with up to 2^b slots) */
+#define ecierthon_CENSUSBUCKETS	32
+
+typedef struct ecierthon_Census {
+  size_t count[ecierthon_CENSUSTYPES];  /* number of objects per type */
+  size_t bytes[ecierthon_CENSUSTYPES];  /* bytes used per type */
+  size_t tcount[ecierthon_CENSUSBUCKETS];  /* tables per size bucket */
+  size_t tbytes[ecierthon_CENSUSBUCKETS];  /* bytes of tables per bucket */
+} ecierthon_Census;
+
+ecierthon_API void (ecierthon_heapcensus) (ecierthon_State *L, ecierthon_Census *c);
+ecierthon_API int (ecierthon_heapsnapshot) (ecierthon_State *L, ecierthon_Writer writer,
+                                            void *data);
+
+
+/*
+** opcode profiling (counting needs a build with 'ecierthonI_OPPROFILE')
+*/
+#define ecierthon_OPPSTOP		0
+#define ecierthon_OPPSTART		1
+#define ecierthon_OPPRESET		2
+#define ecierthon_OPPISRUNNING	3
+
+ecierthon_API int (ecierthon_opprofile) (ecierthon_State *L, int what);
+ecierthon_API const char *(ecierthon_opname) (ecierthon_State *L, int op);
+ecierthon_API size_t (ecierthon_opcount) (ecierthon_State *L, int op1, int op2);
 
 
 /*
@@ -346,6 +420,8 @@ ecierthon_API void      (ecierthon_setallocf) (ecierthon_State *L, ecierthon_All
 
 ecierthon_API void  (ecierthon_toclose) (ecierthon_State *L, int idx);
 
+ecierthon_API void  (ecierthon_setselectf) (ecierthon_State *L, ecierthon_CFunction f);
+
 
 /*
 ** {==============================================================
@@ -428,6 +504,7 @@ ecierthon_API void  (ecierthon_toclose) (ecierthon_State *L, int idx);
 #define ecierthon_HOOKLINE	2
 #define ecierthon_HOOKCOUNT	3
 #define ecierthon_HOOKTAILCALL 4
+#define ecierthon_HOOKBUDGET	5
 
 
 /*
@@ -444,9 +521,13 @@ typedef struct ecierthon_Debug ecierthon_Debug;  /* activation record */
 /* Functions to be called by the debugger in specific events */
 typedef void (*ecierthon_Hook) (ecierthon_State *L, ecierthon_Debug *ar);
 
+/* Function to be called for a pending interrupt */
+typedef void (*ecierthon_Interrupt) (ecierthon_State *L, int code);
+
 
 ecierthon_API int (ecierthon_getstack) (ecierthon_State *L, int level, ecierthon_Debug *ar);
 ecierthon_API int (ecierthon_getinfo) (ecierthon_State *L, const char *what, ecierthon_Debug *ar);
+ecierthon_API int (ecierthon_getpretenured) (ecierthon_State *L, int n, ecierthon_Debug *ar);
 ecierthon_API const char *(ecierthon_getlocal) (ecierthon_State *L, const ecierthon_Debug *ar, int n);
 ecierthon_API const char *(ecierthon_setlocal) (ecierthon_State *L, const ecierthon_Debug *ar, int n);
 ecierthon_API const char *(ecierthon_getupvalue) (ecierthon_State *L, int funcindex, int n);
@@ -461,6 +542,12 @@ ecierthon_API ecierthon_Hook (ecierthon_gethook) (ecierthon_State *L);
 ecierthon_API int (ecierthon_gethookmask) (ecierthon_State *L);
 ecierthon_API int (ecierthon_gethookcount) (ecierthon_State *L);
 
+ecierthon_API void (ecierthon_setbudget) (ecierthon_State *L, ecierthon_Hook func, int count);
+ecierthon_API int (ecierthon_getbudget) (ecierthon_State *L);
+
+ecierthon_API void (ecierthon_interrupt) (ecierthon_State *L, int code);
+ecierthon_API void (ecierthon_setinterrupt) (ecierthon_State *L, ecierthon_Interrupt f);
+
 ecierthon_API int (ecierthon_setcstacklimit) (ecierthon_State *L, unsigned int limit);
 
 struct ecierthon_Debug {
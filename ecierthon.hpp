@@ -1,6 +1,8 @@
 // ecierthon.hpp
 // ecierthon header files for C++
 // <<extern "C">> not supplied automatically because ecierthon also compiles as C++
+// (a core built with 'make cpp' has C++ linkage: include the headers
+// directly instead of this file)
 
 extern "C" {
 #include "ecierthon.h"
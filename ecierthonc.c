@@ -186,7 +186,7 @@ static int pmain(ecierthon_State* L)
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
   if (D==NULL) cannot("open");
   ecierthon_lock(L);
-  ecierthonU_dump(L,f,writer,D,stripping);
+  ecierthonU_dump(L,f,writer,D,stripping,0);
   ecierthon_unlock(L);
   if (ferror(D)) cannot("write");
   if (fclose(D)) cannot("close");
@@ -285,6 +285,9 @@ static void PrintType(const Proto* f, int i)
   case ecierthon_VLNGSTR:
 	printf("S");
 	break;
+  case ecierthon_VTABLE:
+	printf("T");
+	break;
   default:				/* cannot happen */
 	printf("?%d",ttypetag(o));
 	break;
@@ -321,6 +324,9 @@ static void PrintConstant(const Proto* f, int i)
   case ecierthon_VLNGSTR:
 	PrintString(tsvalue(o));
 	break;
+  case ecierthon_VTABLE:
+	printf("table");
+	break;
   default:				/* cannot happen */
 	printf("?%d",ttypetag(o));
 	break;
@@ -356,8 +362,13 @@ static void PrintCode(const Proto* f)
   switch (o)
   {
    case OP_MOVE:
+   case OP_MOVE2:
 	printf("%d %d",a,b);
 	break;
+   case OP_CHECKTYPE:
+	printf("%d %d %d",a,b,isk);
+	printf(COMMENT "%s",isk ? "float" : "int");
+	break;
    case OP_LOADI:
 	printf("%d %d",a,sbx);
 	break;
@@ -393,11 +404,20 @@ static void PrintCode(const Proto* f)
 	printf("%d %d",a,b);
 	printf(COMMENT "%s",UPVALNAME(b));
 	break;
+   case OP_GETFLAT:
+	printf("%d %d",a,b);
+	printf(COMMENT "%s",UPVALNAME(b));
+	break;
    case OP_GETTABUP:
 	printf("%d %d %d",a,b,c);
 	printf(COMMENT "%s",UPVALNAME(b));
 	printf(" "); PrintConstant(f,c);
 	break;
+   case OP_GETTABFLAT:
+	printf("%d %d %d",a,b,c);
+	printf(COMMENT "%s",UPVALNAME(b));
+	printf(" "); PrintConstant(f,c);
+	break;
    case OP_GETTABLE:
 	printf("%d %d %d",a,b,c);
 	break;
@@ -405,6 +425,7 @@ static void PrintCode(const Proto* f)
 	printf("%d %d %d",a,b,c);
 	break;
    case OP_GETFIELD:
+   case OP_GETFIELD2:
 	printf("%d %d %d",a,b,c);
 	printf(COMMENT); PrintConstant(f,c);
 	break;
@@ -414,6 +435,12 @@ static void PrintCode(const Proto* f)
 	printf(" "); PrintConstant(f,b);
 	if (isk) { printf(" "); PrintConstant(f,c); }
 	break;
+   case OP_SETTABFLAT:
+	printf("%d %d %d%s",a,b,c,ISK);
+	printf(COMMENT "%s",UPVALNAME(a));
+	printf(" "); PrintConstant(f,b);
+	if (isk) { printf(" "); PrintConstant(f,c); }
+	break;
    case OP_SETTABLE:
 	printf("%d %d %d%s",a,b,c,ISK);
 	if (isk) { printf(COMMENT); PrintConstant(f,c); }
@@ -423,6 +450,7 @@ static void PrintCode(const Proto* f)
 	if (isk) { printf(COMMENT); PrintConstant(f,c); }
 	break;
    case OP_SETFIELD:
+   case OP_SETFIELD2:
 	printf("%d %d %d%s",a,b,c,ISK);
 	printf(COMMENT); PrintConstant(f,b);
 	if (isk) { printf(" "); PrintConstant(f,c); }
@@ -431,6 +459,10 @@ static void PrintCode(const Proto* f)
 	printf("%d %d %d",a,b,c);
 	printf(COMMENT "%d",c+EXTRAARGC);
 	break;
+   case OP_NEWTABLEK:
+	printf("%d %d",a,bx);
+	printf(COMMENT); PrintConstant(f,bx);
+	break;
    case OP_SELF:
 	printf("%d %d %d%s",a,b,c,ISK);
 	if (isk) { printf(COMMENT); PrintConstant(f,c); }
@@ -520,6 +552,27 @@ static void PrintCode(const Proto* f)
    case OP_SHR:
 	printf("%d %d %d",a,b,c);
 	break;
+   case OP_ADDII:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_SUBII:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_MULII:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_ADDFF:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_SUBFF:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_MULFF:
+	printf("%d %d %d",a,b,c);
+	break;
+   case OP_DIVFF:
+	printf("%d %d %d",a,b,c);
+	break;
    case OP_MMBIN:
 	printf("%d %d %d",a,b,c);
 	printf(COMMENT "%s",eventname(c));
@@ -559,6 +612,10 @@ static void PrintCode(const Proto* f)
 	printf("%d",GETARG_sJ(i));
 	printf(COMMENT "to %d",GETARG_sJ(i)+pc+2);
 	break;
+   case OP_SWITCH:
+	printf("%d %d",a,bx);
+	printf(COMMENT); PrintConstant(f,bx);
+	break;
    case OP_EQ:
 	printf("%d %d %d",a,b,isk);
 	break;
@@ -587,6 +644,18 @@ static void PrintCode(const Proto* f)
    case OP_GEI:
 	printf("%d %d %d",a,sb,isk);
 	break;
+   case OP_LTII:
+	printf("%d %d %d",a,b,isk);
+	break;
+   case OP_LEII:
+	printf("%d %d %d",a,b,isk);
+	break;
+   case OP_LTFF:
+	printf("%d %d %d",a,b,isk);
+	break;
+   case OP_LEFF:
+	printf("%d %d %d",a,b,isk);
+	break;
    case OP_TEST:
 	printf("%d %d",a,isk);
 	break;
@@ -594,6 +663,7 @@ static void PrintCode(const Proto* f)
 	printf("%d %d %d",a,b,isk);
 	break;
    case OP_CALL:
+   case OP_CALLL:
 	printf("%d %d %d",a,b,c);
 	printf(COMMENT);
 	if (b==0) printf("all in "); else printf("%d in ",b-1);
@@ -621,6 +691,27 @@ static void PrintCode(const Proto* f)
 	printf("%d %d",a,bx);
 	printf(COMMENT "to %d",pc+bx+2);
 	break;
+   case OP_FORPREPH:
+	printf("%d %d",a,bx);
+	printf(COMMENT "to %d, hoist %d",pc+bx+2,pc+bx+3);
+	break;
+   case OP_HOISTUP:
+	printf("%d %d %d",a,b,c);
+	printf(COMMENT "%s",UPVALNAME(b));
+	printf(" "); PrintConstant(f,c);
+	break;
+   case OP_HOISTFIELD:
+	printf("%d %d %d",a,b,c);
+	printf(COMMENT); PrintConstant(f,c);
+	break;
+   case OP_HOISTDONE:
+	printf("%d %d",a,bx);
+	printf(COMMENT "to %d",pc-bx+2);
+	break;
+   case OP_GETHOIST:
+	printf("%d %d %d",a,b,c);
+	printf(COMMENT "to %d",pc+c+2);
+	break;
    case OP_TFORPREP:
 	printf("%d %d",a,bx);
 	printf(COMMENT "to %d",pc+bx+2);
@@ -645,6 +736,9 @@ static void PrintCode(const Proto* f)
 	printf(COMMENT);
 	if (c==0) printf("all out"); else printf("%d out",c-1);
 	break;
+   case OP_SELECT:
+	printf("%d",a);
+	break;
    case OP_VARARGPREP:
 	printf("%d",a);
 	break;
@@ -70,6 +70,15 @@
 #endif
 
 
+/*
+@@ ecierthon_USE_STACKRESERVE gives each thread a mapping with room for
+** its largest possible stack, so that stacks grow in place (with
+** pages provided by the system on demand) instead of being copied.
+** It needs POSIX anonymous mappings.
+*/
+/* #define ecierthon_USE_STACKRESERVE */
+
+
 /*
 @@ ecierthonI_IS32INT is true iff 'int' has (at least) 32 bits.
 */
@@ -867,6 +867,7 @@ static void aux_rawset (ecierthon_State *L, int idx, TValue *key, int n) {
   t = gettable(L, idx);
   slot = ecierthonH_set(L, t, key);
   setobj2t(L, slot, s2v(L->top - 1));
+  ecierthonH_touch(L, t);
   invalidateTMcache(t);
   ecierthonC_barrierback(L, obj2gco(t), s2v(L->top - 1));
   L->top -= n;
@@ -892,6 +893,7 @@ ecierthon_API void ecierthon_rawseti (ecierthon_State *L, int idx, ecierthon_Int
   api_checknelems(L, 1);
   t = gettable(L, idx);
   ecierthonH_setint(L, t, n, s2v(L->top - 1));
+  ecierthonH_touch(L, t);
   ecierthonC_barrierback(L, obj2gco(t), s2v(L->top - 1));
   L->top--;
   ecierthon_unlock(L);
@@ -1051,6 +1053,31 @@ ecierthon_API int ecierthon_pcallk (ecierthon_State *L, int nargs, int nresults,
 }
 
 
+/*
+** Set the global table as the first upvalue (may be ecierthon_ENV) of
+** a newly loaded function.
+*/
+static void setglobalenv (ecierthon_State *L) {
+  LClosure *f;
+  if (!ttisLclosure(s2v(L->top - 1)))  /* data-only chunk? */
+    return;  /* no environment */
+  f = clLvalue(s2v(L->top - 1));  /* get newly created function */
+  if (f->nupvalues >= 1) {  /* does it have an upvalue? */
+    /* get global table from registry */
+    Table *reg = hvalue(&G(L)->l_registry);
+    const TValue *gt = ecierthonH_getint(reg, ecierthon_RIDX_GLOBALS);
+    if (isflatupval(f, 0)) {
+      setobj(L, &f->upvals[0].v, gt);
+      ecierthonC_barrier(L, f, gt);
+    }
+    else {
+      setobj(L, f->upvals[0].uv->v, gt);
+      ecierthonC_barrier(L, f->upvals[0].uv, gt);
+    }
+  }
+}
+
+
 ecierthon_API int ecierthon_load (ecierthon_State *L, ecierthon_Reader reader, void *data,
                       const char *chunkname, const char *mode) {
   ZIO z;
@@ -1058,18 +1085,9 @@ ecierthon_API int ecierthon_load (ecierthon_State *L, ecierthon_Reader reader, v
   ecierthon_lock(L);
   if (!chunkname) chunkname = "?";
   ecierthonZ_init(L, &z, reader, data);
-  status = ecierthonD_protectedparser(L, &z, chunkname, mode);
-  if (status == ecierthon_OK) {  /* no errors? */
-    LClosure *f = clLvalue(s2v(L->top - 1));  /* get newly created function */
-    if (f->nupvalues >= 1) {  /* does it have an upvalue? */
-      /* get global table from registry */
-      Table *reg = hvalue(&G(L)->l_registry);
-      const TValue *gt = ecierthonH_getint(reg, ecierthon_RIDX_GLOBALS);
-      /* set global table as 1st upvalue of 'f' (may be ecierthon_ENV) */
-      setobj(L, f->upvals[0]->v, gt);
-      ecierthonC_barrier(L, f->upvals[0], gt);
-    }
-  }
+  status = ecierthonD_protectedparser(L, &z, chunkname, mode, NULL);
+  if (status == ecierthon_OK)  /* no errors? */
+    setglobalenv(L);
   ecierthon_unlock(L);
   return status;
 }
@@ -1082,7 +1100,7 @@ ecierthon_API int ecierthon_dump (ecierthon_State *L, ecierthon_Writer writer, v
   api_checknelems(L, 1);
   o = s2v(L->top - 1);
   if (isLfunction(o))
-    status = ecierthonU_dump(L, getproto(o), writer, data, strip);
+    status = ecierthonU_dump(L, getproto(o), writer, data, strip, 0);
   else
     status = 1;
   ecierthon_unlock(L);
@@ -1090,6 +1108,70 @@ ecierthon_API int ecierthon_dump (ecierthon_State *L, ecierthon_Writer writer, v
 }
 
 
+/*
+** Create a block with the code of the ecierthon function at 'idx' that
+** other states can load with 'ecierthon_loadshared'. Returns NULL if
+** the value is not a ecierthon function or there is no memory.
+*/
+ecierthon_API ecierthon_Shared *ecierthon_share (ecierthon_State *L, int idx) {
+  ecierthon_Shared *s = NULL;
+  const TValue *o;
+  ecierthon_lock(L);
+  o = index2value(L, idx);
+  if (isLfunction(o)) {
+    s = ecierthonF_share(L, getproto(o));
+    G(L)->resepoch++;
+  }
+  ecierthon_unlock(L);
+  return s;
+}
+
+
+typedef struct SharedReader {
+  const char *dump;
+  size_t size;
+} SharedReader;
+
+
+static const char *getshared (ecierthon_State *L, void *ud, size_t *size) {
+  SharedReader *sr = (SharedReader *)ud;
+  UNUSED(L);
+  if (sr->size == 0) return NULL;
+  *size = sr->size;
+  sr->size = 0;  /* the whole dump is read at once */
+  return sr->dump;
+}
+
+
+/*
+** Push a new function whose prototypes use the code in block 's'.
+*/
+ecierthon_API int ecierthon_loadshared (ecierthon_State *L, ecierthon_Shared *s) {
+  SharedReader sr;
+  ZIO z;
+  int status;
+  ecierthon_lock(L);
+  sr.dump = s->dump;
+  sr.size = s->dumpsize;
+  ecierthonZ_init(L, &z, getshared, &sr);
+  status = ecierthonD_protectedparser(L, &z, "=(shared)", "b", s);
+  G(L)->resepoch++;  /* 's' may have gained references */
+  if (status == ecierthon_OK)
+    setglobalenv(L);
+  ecierthon_unlock(L);
+  return status;
+}
+
+
+/*
+** Release the reference returned by 'ecierthon_share'. The block lives
+** while the prototypes loaded from it are alive.
+*/
+ecierthon_API void ecierthon_unshare (ecierthon_Shared *s) {
+  ecierthonF_unshare(s);
+}
+
+
 ecierthon_API int ecierthon_status (ecierthon_State *L) {
   return L->status;
 }
@@ -1121,11 +1203,11 @@ ecierthon_API int ecierthon_gc (ecierthon_State *L, int what, ...) {
     }
     case ecierthon_GCCOUNT: {
       /* GC values are expressed in Kbytes: #bytes/2^10 */
-      res = cast_int(gettotalbytes(g) >> 10);
+      res = cast_int(getheapbytes(g) >> 10);
       break;
     }
     case ecierthon_GCCOUNTB: {
-      res = cast_int(gettotalbytes(g) & 0x3ff);
+      res = cast_int(getheapbytes(g) & 0x3ff);
       break;
     }
     case ecierthon_GCSTEP: {
@@ -1147,6 +1229,14 @@ ecierthon_API int ecierthon_gc (ecierthon_State *L, int what, ...) {
         res = 1;  /* signal it */
       break;
     }
+    case ecierthon_GCSTEPTIME: {
+      int usecs = va_arg(argp, int);
+      lu_byte oldrunning = g->gcrunning;
+      g->gcrunning = 1;  /* allow GC to run */
+      res = ecierthonC_steptime(L, (usecs > 0) ? cast(l_mem, usecs) : 0);
+      g->gcrunning = oldrunning;  /* restore previous state */
+      break;
+    }
     case ecierthon_GCSETPAUSE: {
       int data = va_arg(argp, int);
       res = getgcparam(g->gcpause);
@@ -1171,6 +1261,7 @@ ecierthon_API int ecierthon_gc (ecierthon_State *L, int what, ...) {
         g->genminormul = minormul;
       if (majormul != 0)
         setgcparam(g->genmajormul, majormul);
+      ecierthonC_setadaptive(L, 0);  /* mode chosen explicitly */
       ecierthonC_changemode(L, KGC_GEN);
       break;
     }
@@ -1185,9 +1276,22 @@ ecierthon_API int ecierthon_gc (ecierthon_State *L, int what, ...) {
         setgcparam(g->gcstepmul, stepmul);
       if (stepsize != 0)
         g->gcstepsize = stepsize;
+      ecierthonC_setadaptive(L, 0);  /* mode chosen explicitly */
       ecierthonC_changemode(L, KGC_INC);
       break;
     }
+    case ecierthon_GCPRETENURE: {
+      int on = va_arg(argp, int);
+      res = g->gcpretenure;
+      ecierthonC_setpretenure(L, on);
+      break;
+    }
+    case ecierthon_GCADAPTIVE: {
+      int target = va_arg(argp, int);
+      res = isdecGCmodegen(g) ? ecierthon_GCGEN : ecierthon_GCINC;
+      ecierthonC_setadaptive(L, (target > 0) ? cast(l_mem, target) : 0);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   va_end(argp);
@@ -1196,6 +1300,84 @@ ecierthon_API int ecierthon_gc (ecierthon_State *L, int what, ...) {
 }
 
 
+/*
+** Declares 'delta' bytes of memory allocated (or, if negative, released)
+** outside the collector, so that its pace reflects them. These bytes
+** are kept apart in 'GCextbytes': they do not count as memory in use by
+** the state, and those never released are dropped when it closes.
+*/
+ecierthon_API void ecierthon_gcadjust (ecierthon_State *L, ptrdiff_t delta) {
+  global_State *g;
+  ecierthon_lock(L);
+  g = G(L);
+  api_check(L, delta >= 0 || cast(lu_mem, -delta) <= g->GCextbytes,
+                "invalid external memory release");
+  g->GCextbytes += cast(lu_mem, delta);
+  g->GCdebt += cast(l_mem, delta);
+  if (delta != 0)
+    g->resepoch++;
+  ecierthonC_checkGC(L);
+  ecierthon_unlock(L);
+}
+
+
+/*
+** Sets the amount of external memory owned by the full userdata at
+** 'idx', returning the previous amount. That memory counts for the
+** collector until the userdata is finalized or collected.
+*/
+ecierthon_API size_t ecierthon_setexternalsize (ecierthon_State *L, int idx, size_t size) {
+  Udata *u;
+  size_t old;
+  TValue *o;
+  ecierthon_lock(L);
+  o = index2value(L, idx);
+  api_check(L, ttisfulluserdata(o), "full userdata expected");
+  u = uvalue(o);
+  old = u->extsize;
+  u->extsize = size;
+  G(L)->GCextbytes += size - old;
+  G(L)->GCdebt += cast(l_mem, size) - cast(l_mem, old);
+  if (size != old)
+    G(L)->resepoch++;
+  ecierthonC_checkGC(L);
+  ecierthon_unlock(L);
+  return old;
+}
+
+
+/*
+** Returns a counter that changes whenever the state acquires or
+** releases something outside its allocator: an object gets or runs a
+** finalizer, external memory is declared, a stack gets its own
+** mapping, or shared code gains or loses a reference.
+*/
+ecierthon_API size_t ecierthon_resourceepoch (ecierthon_State *L) {
+  size_t e;
+  ecierthon_lock(L);
+  e = cast_sizet(G(L)->resepoch);
+  ecierthon_unlock(L);
+  return e;
+}
+
+
+ecierthon_API void ecierthon_heapcensus (ecierthon_State *L, ecierthon_Census *c) {
+  ecierthon_lock(L);
+  ecierthonC_census(L, c);
+  ecierthon_unlock(L);
+}
+
+
+ecierthon_API int ecierthon_heapsnapshot (ecierthon_State *L, ecierthon_Writer writer,
+                                          void *data) {
+  int status;
+  ecierthon_lock(L);
+  status = ecierthonC_snapshot(L, writer, data);
+  ecierthon_unlock(L);
+  return status;
+}
+
+
 
 /*
 ** miscellaneous functions
@@ -1292,6 +1474,17 @@ ecierthon_API void ecierthon_setallocf (ecierthon_State *L, ecierthon_Alloc f, v
 }
 
 
+/*
+** Register 'f' as the standard 'select'. Calls 'select(x, ...)' that
+** find this function are run by the VM straight from the vararg area.
+*/
+ecierthon_API void ecierthon_setselectf (ecierthon_State *L, ecierthon_CFunction f) {
+  ecierthon_lock(L);
+  G(L)->selectf = f;
+  ecierthon_unlock(L);
+}
+
+
 void ecierthon_setwarnf (ecierthon_State *L, ecierthon_WarnFunction f, void *ud) {
   ecierthon_lock(L);
   G(L)->ud_warn = ud;
@@ -1339,8 +1532,14 @@ static const char *aux_upvalue (TValue *fi, int n, TValue **val,
       Proto *p = f->p;
       if (!(cast_uint(n) - 1u  < cast_uint(p->sizeupvalues)))
         return NULL;  /* 'n' not in [1, p->sizeupvalues] */
-      *val = f->upvals[n-1]->v;
-      if (owner) *owner = obj2gco(f->upvals[n - 1]);
+      if (isflatupval(f, n - 1)) {
+        *val = &f->upvals[n - 1].v;
+        if (owner) *owner = obj2gco(f);
+      }
+      else {
+        *val = f->upvals[n - 1].uv->v;
+        if (owner) *owner = obj2gco(f->upvals[n - 1].uv);
+      }
       name = p->upvalues[n-1].name;
       return (name == NULL) ? "(no name)" : getstr(name);
     }
@@ -1374,6 +1573,8 @@ ecierthon_API const char *ecierthon_setupvalue (ecierthon_State *L, int funcinde
   name = aux_upvalue(fi, n, &val, &owner);
   if (name) {
     L->top--;
+    if (ttistable(val))  /* old value may be the root of hoisted loads */
+      ecierthonH_touch(L, hvalue(val));
     setobj(L, val, s2v(L->top));
     ecierthonC_barrier(L, owner, val);
   }
@@ -1382,17 +1583,17 @@ ecierthon_API const char *ecierthon_setupvalue (ecierthon_State *L, int funcinde
 }
 
 
-static UpVal **getupvalref (ecierthon_State *L, int fidx, int n, LClosure **pf) {
-  static const UpVal *const nullup = NULL;
+static UpValSlot *getupvalref (ecierthon_State *L, int fidx, int n,
+                               LClosure **pf) {
   LClosure *f;
   TValue *fi = index2value(L, fidx);
   api_check(L, ttisLclosure(fi), "ecierthon function expected");
   f = clLvalue(fi);
   if (pf) *pf = f;
   if (1 <= n && n <= f->p->sizeupvalues)
-    return &f->upvals[n - 1];  /* get its upvalue pointer */
+    return &f->upvals[n - 1];  /* get its upvalue slot */
   else
-    return (UpVal**)&nullup;
+    return NULL;
 }
 
 
@@ -1400,7 +1601,14 @@ ecierthon_API void *ecierthon_upvalueid (ecierthon_State *L, int fidx, int n) {
   TValue *fi = index2value(L, fidx);
   switch (ttypetag(fi)) {
     case ecierthon_VLCL: {  /* ecierthon closure */
-      return *getupvalref(L, fidx, n, NULL);
+      LClosure *f;
+      UpValSlot *up = getupvalref(L, fidx, n, &f);
+      if (up == NULL)
+        return NULL;
+      else if (isflatupval(f, n - 1))
+        return up;  /* a flat value is identified by its slot */
+      else
+        return up->uv;
     }
     case ecierthon_VCCL: {  /* C closure */
       CClosure *f = clCvalue(fi);
@@ -1420,12 +1628,16 @@ ecierthon_API void *ecierthon_upvalueid (ecierthon_State *L, int fidx, int n) {
 
 ecierthon_API void ecierthon_upvaluejoin (ecierthon_State *L, int fidx1, int n1,
                                             int fidx2, int n2) {
-  LClosure *f1;
-  UpVal **up1 = getupvalref(L, fidx1, n1, &f1);
-  UpVal **up2 = getupvalref(L, fidx2, n2, NULL);
-  api_check(L, *up1 != NULL && *up2 != NULL, "invalid upvalue index");
-  *up1 = *up2;
-  ecierthonC_objbarrier(L, f1, *up1);
+  LClosure *f1, *f2;
+  UpValSlot *up1 = getupvalref(L, fidx1, n1, &f1);
+  UpValSlot *up2 = getupvalref(L, fidx2, n2, &f2);
+  api_check(L, up1 != NULL && up2 != NULL, "invalid upvalue index");
+  if (isflatupval(f1, n1 - 1) || isflatupval(f2, n2 - 1))
+    ecierthonG_runerror(L, "cannot join a flat upvalue");
+  if (ttistable(up1->uv->v))  /* old value may be the root of hoisted loads */
+    ecierthonH_touch(L, hvalue(up1->uv->v));
+  up1->uv = up2->uv;
+  ecierthonC_objbarrier(L, f1, up1->uv);
 }
 
 
@@ -787,6 +787,18 @@ ecierthonLIB_API int ecierthonL_loadfilex (ecierthon_State *L, const char *filen
 }
 
 
+/*
+** Reads a data-only file (a single literal value, such as a table
+** constructor, optionally preceded by 'return') and pushes its value.
+*/
+ecierthonLIB_API int ecierthonL_loaddata (ecierthon_State *L, const char *filename) {
+  int status = ecierthonL_loadfilex(L, filename, "d");
+  if (status == ecierthon_OK)
+    ecierthon_call(L, 0, 1);  /* get the value */
+  return status;
+}
+
+
 typedef struct LoadS {
   const char *s;
   size_t size;
@@ -1072,6 +1084,223 @@ ecierthonLIB_API ecierthon_State *ecierthonL_newstate (void) {
 }
 
 
+/*
+** {======================================================
+** Arena states
+** An arena state gets all its memory from one contiguous block.
+** Freed blocks go to free lists segregated by size class, so a
+** long-running script can reuse its memory. Because the whole state
+** (including the 'ecierthon_State' and 'global_State' structures) lives
+** inside the block at fixed addresses, 'ecierthonL_savebaseline' can keep
+** a byte copy of the used part of the block and 'ecierthonL_resetstate'
+** can return the state to that baseline with a single copy, without
+** traversing or freeing any object. Nothing outside the block can be
+** restored that way, so the state keeps the resource epoch it had at
+** the baseline (see 'ecierthon_resourceepoch') and a reset is refused
+** once that epoch changes: the state must then be closed with
+** 'ecierthonL_closearena', which in that case does a full close.
+** =======================================================
+*/
+
+#define ARENAALIGN	16	/* alignment and granularity of blocks */
+#define ARENASMALL	256	/* largest size in a "small" class */
+#define NSMALLCLASSES	(ARENASMALL / ARENAALIGN)
+#define ARENACLASSES	(NSMALLCLASSES + 8 * sizeof(size_t))
+
+#define arenaround(s)	(((s) + (ARENAALIGN - 1)) & ~(size_t)(ARENAALIGN - 1))
+
+
+/* arena header, kept at the start of the block (and so in the baseline) */
+typedef struct ArenaHeader {
+  char *top;  /* first never-used byte */
+  void *freeblocks[ARENACLASSES];  /* free blocks for each size class */
+} ArenaHeader;
+
+
+/* control structure, outside the block; it is the allocator's 'ud' */
+typedef struct Arena {
+  char *base;  /* the block itself */
+  char *limit;  /* end of the block */
+  char *image;  /* copy of the block at the baseline (NULL if none) */
+  size_t imagesize;  /* size of that copy */
+  size_t epoch;  /* resource epoch at the baseline (or at creation) */
+} Arena;
+
+
+#define arenaheader(a)	((ArenaHeader *)(a)->base)
+
+
+/*
+** Size class for blocks of 'size' bytes: one class for each multiple
+** of ARENAALIGN up to ARENASMALL, then one for each power of 2.
+** Sets '*bsize' with the actual size of the blocks in that class.
+*/
+static int arenaclass (size_t size, size_t *bsize) {
+  if (size <= ARENASMALL) {
+    *bsize = arenaround(size);
+    return (int)(*bsize / ARENAALIGN) - 1;
+  }
+  else {
+    int c = NSMALLCLASSES;
+    size_t s = ARENASMALL * 2;
+    while (s < size) {
+      s <<= 1;
+      c++;
+    }
+    *bsize = s;
+    return c;
+  }
+}
+
+
+static void *arenamalloc (Arena *a, size_t size) {
+  ArenaHeader *h = arenaheader(a);
+  size_t bsize;
+  int c = arenaclass(size, &bsize);
+  void *block = h->freeblocks[c];
+  if (block != NULL)  /* reuse a free block? */
+    h->freeblocks[c] = *(void **)block;
+  else if (bsize <= (size_t)(a->limit - h->top)) {  /* room at the top? */
+    block = h->top;
+    h->top += bsize;
+  }
+  return block;  /* NULL if no memory */
+}
+
+
+static void arenafree (Arena *a, void *block, size_t size) {
+  ArenaHeader *h = arenaheader(a);
+  size_t bsize;
+  int c = arenaclass(size, &bsize);
+  *(void **)block = h->freeblocks[c];
+  h->freeblocks[c] = block;
+}
+
+
+static void *arena_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
+  Arena *a = (Arena *)ud;
+  if (ptr == NULL)  /* 'osize' is a type tag */
+    return (nsize == 0) ? NULL : arenamalloc(a, nsize);
+  else if (nsize == 0) {
+    arenafree(a, ptr, osize);
+    return NULL;
+  }
+  else {
+    size_t obsize, nbsize;
+    void *block;
+    if (arenaclass(osize, &obsize) == arenaclass(nsize, &nbsize))
+      return ptr;  /* block already has the right size */
+    block = arenamalloc(a, nsize);
+    if (block == NULL)
+      return (nsize <= osize) ? ptr : NULL;  /* shrinking cannot fail */
+    memcpy(block, ptr, (osize < nsize) ? osize : nsize);
+    arenafree(a, ptr, osize);
+    return block;
+  }
+}
+
+
+/* returns the arena of 'L', or NULL if 'L' is not an arena state */
+static Arena *getarena (ecierthon_State *L) {
+  void *ud;
+  return (ecierthon_getallocf(L, &ud) == arena_alloc) ? (Arena *)ud : NULL;
+}
+
+
+/*
+** Creates a state whose memory comes from an arena of 'size' bytes.
+** Once the arena is exhausted, allocations fail with a memory error.
+*/
+ecierthonLIB_API ecierthon_State *ecierthonL_newarenastate (size_t size) {
+  ecierthon_State *L;
+  Arena *a = (Arena *)malloc(sizeof(Arena));
+  size_t hsize = arenaround(sizeof(ArenaHeader));
+  size = arenaround(size);
+  if (a == NULL || size <= hsize || (a->base = (char *)malloc(size)) == NULL) {
+    free(a);
+    return NULL;
+  }
+  a->limit = a->base + size;
+  a->image = NULL;
+  a->imagesize = 0;
+  memset(a->base, 0, hsize);  /* empty free lists */
+  arenaheader(a)->top = a->base + hsize;
+  L = ecierthon_newstate(arena_alloc, a);
+  if (L) {
+    ecierthon_atpanic(L, &panic);
+    ecierthon_setwarnf(L, warnfoff, L);  /* default is warnings off */
+    a->epoch = ecierthon_resourceepoch(L);
+  }
+  else {
+    free(a->base);
+    free(a);
+  }
+  return L;
+}
+
+
+/*
+** Records the current contents of the arena of 'L' as the baseline
+** for 'ecierthonL_resetstate' (typically right after opening the
+** libraries). No function can be running in the state. Returns 0 if
+** 'L' is not an arena state or there is no memory for the copy.
+*/
+ecierthonLIB_API int ecierthonL_savebaseline (ecierthon_State *L) {
+  Arena *a = getarena(L);
+  size_t size;
+  char *image;
+  if (a == NULL)
+    return 0;
+  size = (size_t)(arenaheader(a)->top - a->base);
+  image = (char *)realloc(a->image, size);
+  if (image == NULL)
+    return 0;
+  memcpy(image, a->base, size);
+  a->image = image;
+  a->imagesize = size;
+  a->epoch = ecierthon_resourceepoch(L);
+  return 1;
+}
+
+
+/*
+** Returns the arena state 'L' to its baseline, dropping everything
+** created after it. 'L' must be the main thread, with no function
+** running; other pointers into the state become invalid. Returns 0,
+** leaving the state untouched, if 'L' is not an arena state, has no
+** baseline, or has acquired or released resources outside its arena
+** since the baseline.
+*/
+ecierthonLIB_API int ecierthonL_resetstate (ecierthon_State *L) {
+  Arena *a = getarena(L);
+  if (a == NULL || a->image == NULL || ecierthon_resourceepoch(L) != a->epoch)
+    return 0;
+  memcpy(a->base, a->image, a->imagesize);
+  return 1;
+}
+
+
+/*
+** Closes an arena state. If the state has not touched resources
+** outside its arena since the baseline (or since its creation), it
+** just drops the whole arena, without calling the finalizers of
+** objects older than the baseline; otherwise it first closes the
+** state as 'ecierthon_close' does.
+*/
+ecierthonLIB_API void ecierthonL_closearena (ecierthon_State *L) {
+  Arena *a = getarena(L);
+  if (a == NULL || ecierthon_resourceepoch(L) != a->epoch)
+    ecierthon_close(L);
+  if (a != NULL) {
+    free(a->image);
+    free(a->base);
+    free(a);
+  }
+}
+
+/* }====================================================== */
+
+
 ecierthonLIB_API void ecierthonL_checkversion_ (ecierthon_State *L, ecierthon_Number ver, size_t sz) {
   ecierthon_Number v = ecierthon_version(L);
   if (sz != ecierthonL_NUMSIZES)  /* check numeric types */
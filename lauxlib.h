@@ -92,6 +92,7 @@ ecierthonLIB_API int (ecierthonL_loadfilex) (ecierthon_State *L, const char *fil
                                                const char *mode);
 
 #define ecierthonL_loadfile(L,f)	ecierthonL_loadfilex(L,f,NULL)
+ecierthonLIB_API int (ecierthonL_loaddata) (ecierthon_State *L, const char *filename);
 
 ecierthonLIB_API int (ecierthonL_loadbufferx) (ecierthon_State *L, const char *buff, size_t sz,
                                    const char *name, const char *mode);
@@ -99,6 +100,23 @@ ecierthonLIB_API int (ecierthonL_loadstring) (ecierthon_State *L, const char *s)
 
 ecierthonLIB_API ecierthon_State *(ecierthonL_newstate) (void);
 
+/*
+** Arena states. 'ecierthonL_resetstate' restores a byte copy of the arena
+** taken by 'ecierthonL_savebaseline', and so cannot restore resources
+** living outside the arena. It fails (returning 0) if the state has
+** touched any of them since its baseline, as tracked by
+** 'ecierthon_resourceepoch': files opened or closed, objects given or
+** running a finalizer, external memory, stacks in their own mappings
+** (ecierthon_USE_STACKRESERVE), or shared code. The state must then be
+** closed with 'ecierthonL_closearena'. Code shared by an arena state
+** ('ecierthon_share') lives in its arena, so other states must not
+** load it.
+*/
+ecierthonLIB_API ecierthon_State *(ecierthonL_newarenastate) (size_t size);
+ecierthonLIB_API int (ecierthonL_savebaseline) (ecierthon_State *L);
+ecierthonLIB_API int (ecierthonL_resetstate) (ecierthon_State *L);
+ecierthonLIB_API void (ecierthonL_closearena) (ecierthon_State *L);
+
 ecierthonLIB_API ecierthon_Integer (ecierthonL_len) (ecierthon_State *L, int idx);
 
 ecierthonLIB_API void ecierthonL_addgsub (ecierthonL_Buffer *b, const char *s,
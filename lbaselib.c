@@ -187,13 +187,123 @@ static int pushmode (ecierthon_State *L, int oldmode) {
 }
 
 
+/* 'collectgarbage' options that are not 'ecierthon_gc' options */
+#define GCCENSUS	(-1)
+#define GCSNAPSHOT	(-2)
+#define GCOPPROFILE	(-3)
+#define GCOPCOUNTS	(-4)
+
+
+static void setcensusentry (ecierthon_State *L, size_t count, size_t bytes) {
+  ecierthon_createtable(L, 0, 2);
+  ecierthon_pushinteger(L, (ecierthon_Integer)count);
+  ecierthon_setfield(L, -2, "count");
+  ecierthon_pushinteger(L, (ecierthon_Integer)bytes);
+  ecierthon_setfield(L, -2, "bytes");
+}
+
+
+/*
+** Returns a table with a '{count = n, bytes = b}' entry for each type
+** present in the heap, plus a field 'tablesizes' whose entry 'i' counts
+** tables with up to 2^(i-1) slots.
+*/
+static int pushcensus (ecierthon_State *L) {
+  static const char *const extranames[] = {"upvalue", "proto"};
+  ecierthon_Census c;
+  int i, nb;
+  ecierthon_heapcensus(L, &c);
+  ecierthon_createtable(L, 0, ecierthon_CENSUSTYPES + 1);
+  for (i = 0; i < ecierthon_CENSUSTYPES; i++) {
+    if (c.count[i] > 0) {
+      setcensusentry(L, c.count[i], c.bytes[i]);
+      ecierthon_setfield(L, -2, (i < ecierthon_NUMTYPES) ? ecierthon_typename(L, i)
+                                               : extranames[i - ecierthon_NUMTYPES]);
+    }
+  }
+  for (nb = ecierthon_CENSUSBUCKETS; nb > 0 && c.tcount[nb - 1] == 0; nb--) ;
+  ecierthon_createtable(L, nb, 0);
+  for (i = 0; i < nb; i++) {
+    setcensusentry(L, c.tcount[i], c.tbytes[i]);
+    ecierthon_rawseti(L, -2, i + 1);
+  }
+  ecierthon_setfield(L, -2, "tablesizes");
+  return 1;
+}
+
+
+static int snapwriter (ecierthon_State *L, const void *b, size_t size, void *f) {
+  (void)L;
+  return (fwrite(b, 1, size, (FILE *)f) != size);
+}
+
+
+static int writesnapshot (ecierthon_State *L) {
+  const char *fname = ecierthonL_checkstring(L, 2);
+  FILE *f = fopen(fname, "wb");
+  int status;
+  if (f == NULL)
+    return ecierthonL_fileresult(L, 0, fname);
+  status = ecierthon_heapsnapshot(L, snapwriter, f);
+  status = (fclose(f) == 0 && status == 0);
+  return ecierthonL_fileresult(L, status, fname);
+}
+
+
+static int opprofile (ecierthon_State *L) {
+  static const char *const opts[] = {"isrunning", "start", "stop", "reset",
+    NULL};
+  static const int optsnum[] = {ecierthon_OPPISRUNNING, ecierthon_OPPSTART,
+    ecierthon_OPPSTOP, ecierthon_OPPRESET};
+  int o = optsnum[ecierthonL_checkoption(L, 2, "isrunning", opts)];
+  int res = ecierthon_opprofile(L, o);
+  if (res < 0)  /* no profiler in this build? */
+    ecierthonL_pushfail(L);
+  else
+    ecierthon_pushboolean(L, res);
+  return 1;
+}
+
+
+/*
+** Returns a table with the counts of the opcode profiler: key "OP"
+** counts opcode OP, and key "OP1 OP2" counts OP2 right after OP1.
+*/
+static int pushopcounts (ecierthon_State *L) {
+  const char *a, *b;
+  int i, j;
+  if (ecierthon_opprofile(L, ecierthon_OPPISRUNNING) < 0) {
+    ecierthonL_pushfail(L);  /* no profiler in this build */
+    return 1;
+  }
+  ecierthon_newtable(L);
+  for (i = 0; (a = ecierthon_opname(L, i)) != NULL; i++) {
+    size_t n = ecierthon_opcount(L, i, -1);
+    if (n == 0) continue;
+    ecierthon_pushinteger(L, (ecierthon_Integer)n);
+    ecierthon_setfield(L, -2, a);
+    for (j = 0; (b = ecierthon_opname(L, j)) != NULL; j++) {
+      if ((n = ecierthon_opcount(L, i, j)) > 0) {
+        ecierthon_pushfstring(L, "%s %s", a, b);
+        ecierthon_pushinteger(L, (ecierthon_Integer)n);
+        ecierthon_settable(L, -3);
+      }
+    }
+  }
+  return 1;
+}
+
+
 static int ecierthonB_collectgarbage (ecierthon_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
     "count", "step", "setpause", "setstepmul",
-    "isrunning", "generational", "incremental", NULL};
+    "isrunning", "generational", "incremental", "steptime", "adaptive",
+    "pretenure", "census", "snapshot", "opprofile", "opcounts", NULL};
   static const int optsnum[] = {ecierthon_GCSTOP, ecierthon_GCRESTART, ecierthon_GCCOLLECT,
     ecierthon_GCCOUNT, ecierthon_GCSTEP, ecierthon_GCSETPAUSE, ecierthon_GCSETSTEPMUL,
-    ecierthon_GCISRUNNING, ecierthon_GCGEN, ecierthon_GCINC};
+    ecierthon_GCISRUNNING, ecierthon_GCGEN, ecierthon_GCINC, ecierthon_GCSTEPTIME,
+    ecierthon_GCADAPTIVE, ecierthon_GCPRETENURE, GCCENSUS, GCSNAPSHOT,
+    GCOPPROFILE, GCOPCOUNTS};
   int o = optsnum[ecierthonL_checkoption(L, 1, "collect", opts)];
   switch (o) {
     case ecierthon_GCCOUNT: {
@@ -208,6 +318,12 @@ static int ecierthonB_collectgarbage (ecierthon_State *L) {
       ecierthon_pushboolean(L, res);
       return 1;
     }
+    case ecierthon_GCSTEPTIME: {
+      int usecs = (int)ecierthonL_checkinteger(L, 2);
+      int res = ecierthon_gc(L, o, usecs);
+      ecierthon_pushboolean(L, res);
+      return 1;
+    }
     case ecierthon_GCSETPAUSE:
     case ecierthon_GCSETSTEPMUL: {
       int p = (int)ecierthonL_optinteger(L, 2, 0);
@@ -231,6 +347,23 @@ static int ecierthonB_collectgarbage (ecierthon_State *L) {
       int stepsize = (int)ecierthonL_optinteger(L, 4, 0);
       return pushmode(L, ecierthon_gc(L, o, pause, stepmul, stepsize));
     }
+    case ecierthon_GCADAPTIVE: {
+      int target = (int)ecierthonL_checkinteger(L, 2);
+      return pushmode(L, ecierthon_gc(L, o, target));
+    }
+    case ecierthon_GCPRETENURE: {
+      int on = ecierthon_toboolean(L, 2);
+      ecierthon_pushboolean(L, ecierthon_gc(L, o, on));
+      return 1;
+    }
+    case GCCENSUS:
+      return pushcensus(L);
+    case GCSNAPSHOT:
+      return writesnapshot(L);
+    case GCOPPROFILE:
+      return opprofile(L);
+    case GCOPCOUNTS:
+      return pushopcounts(L);
     default: {
       int res = ecierthon_gc(L, o);
       ecierthon_pushinteger(L, res);
@@ -300,7 +433,7 @@ static int ecierthonB_ipairs (ecierthon_State *L) {
 
 static int load_aux (ecierthon_State *L, int status, int envidx) {
   if (status == ecierthon_OK) {
-    if (envidx != 0) {  /* 'env' parameter? */
+    if (envidx != 0 && !ecierthon_iscfunction(L, -1)) {  /* 'env' parameter? */
       ecierthon_pushvalue(L, envidx);  /* environment for loaded function */
       if (!ecierthon_setupvalue(L, -2, 1))  /* set it as 1st upvalue */
         ecierthon_pop(L, 1);  /* remove 'env' if not used by previous call */
@@ -522,6 +655,7 @@ ecierthonMOD_API int ecierthonopen_base (ecierthon_State *L) {
   /* set global _VERSION */
   ecierthon_pushliteral(L, ecierthon_VERSION);
   ecierthon_setfield(L, -2, "_VERSION");
+  ecierthon_setselectf(L, ecierthonB_select);  /* let the VM run it inline */
   return 1;
 }
 
@@ -67,6 +67,41 @@ static int tonumeral (const expdesc *e, TValue *v) {
 }
 
 
+/*
+** Static numeric type of expression 'e': numeric constants, '<int>'
+** and '<float>' variables, and results of operations over them.
+*/
+static int exptype (const expdesc *e) {
+  if (hasjumps(e))
+    return NTANY;  /* value may come from elsewhere */
+  switch (e->k) {
+    case VKINT: return NTINT;
+    case VKFLT: return NTFLT;
+    case VLOCAL: case VUPVAL: case VNONRELOC: case VRELOC: return e->nt;
+    default: return NTANY;
+  }
+}
+
+
+/*
+** Convert a numeric constant to static type 'nt', if that can be
+** done exactly.
+*/
+static void coercek (expdesc *e, int nt) {
+  if (nt == NTFLT && e->k == VKINT) {
+    e->k = VKFLT;
+    e->u.nval = cast_num(e->u.ival);
+  }
+  else if (nt == NTINT && e->k == VKFLT) {
+    ecierthon_Integer i;
+    if (ecierthonV_flttointeger(e->u.nval, &i, F2Ieq)) {
+      e->k = VKINT;
+      e->u.ival = i;
+    }
+  }
+}
+
+
 /*
 ** Get the constant value from a constant expression
 */
@@ -744,13 +779,103 @@ void ecierthonK_setoneret (FuncState *fs, expdesc *e) {
     ecierthon_assert(GETARG_C(getinstruction(fs, e)) == 2);
     e->k = VNONRELOC;  /* result has fixed position */
     e->u.info = GETARG_A(getinstruction(fs, e));
+    e->nt = NTANY;
   }
   else if (e->k == VVARARG) {
     SETARG_C(getinstruction(fs, e), 2);
     e->k = VRELOC;  /* can relocate its simple result */
+    e->nt = NTANY;
+  }
+}
+
+
+/*
+** {======================================================
+** Loop-invariant loads: inside a numeric loop, a global read through
+** the environment of the chunk and a constant field read from such a
+** global (or from such a field) are also computed once, into a slot of
+** the prototype, before the first iteration (see 'forbody'). The code for
+** each use gets an OP_GETHOIST in front, which uses the hoisted value
+** instead while no watched table has changed.
+** =======================================================
+*/
+
+/*
+** Check whether upvalue 'idx' of 'fs' is the environment of the whole
+** chunk, which no local variable can alias.
+*/
+static int ischunkenv (FuncState *fs, int idx) {
+  while (fs->prev != NULL) {
+    if (fs->f->upvalues[idx].instack)
+      return 0;  /* a local variable of an enclosing function */
+    idx = fs->f->upvalues[idx].idx;
+    fs = fs->prev;
+  }
+  return (idx == 0);  /* first upvalue of the main function */
+}
+
+
+/*
+** Slot holding load 'op' 'b' 'c' in loop 'lh', adding that load if
+** needed. The first load of a loop also takes the two slots of its
+** stamp. Returns -1 if the loop or the function has no room for it.
+*/
+static int hoistslot (FuncState *fs, LoopHoist *lh, OpCode op,
+                      int b, int c) {
+  int i;
+  for (i = 0; i < lh->n; i++) {
+    Instruction ld = lh->load[i];
+    if (GET_OPCODE(ld) == op && GETARG_B(ld) == b && GETARG_C(ld) == c)
+      return GETARG_A(ld);  /* already hoisted */
+  }
+  if (lh->n == MAXHOIST || fs->nhoist + (lh->stamp < 0) * 2 > MAXARG_A)
+    return -1;
+  if (lh->stamp < 0) {  /* first load of this loop? */
+    lh->stamp = fs->nhoist;
+    fs->nhoist += 2;
+  }
+  lh->load[lh->n++] = CREATE_ABCk(op, fs->nhoist, b, c, 0);
+  return fs->nhoist++;
+}
+
+
+/*
+** Global 'e' is about to be loaded: hoist it if possible.
+*/
+static void hoistglobal (FuncState *fs, expdesc *e) {
+  LoopHoist *lh = fs->lh;
+  int h;
+  if (lh != NULL && ischunkenv(fs, e->u.ind.t) &&
+      (h = hoistslot(fs, lh, OP_HOISTUP, e->u.ind.t, e->u.ind.idx)) >= 0)
+    lh->lastuse = ecierthonK_codeABC(fs, OP_GETHOIST, lh->stamp, h, 1);
+}
+
+
+/*
+** Field 'e' is about to be loaded. If its table is a hoisted value
+** just loaded into a temporary register, hoist the field too, making
+** its load part of the same use.
+*/
+static void hoistfield (FuncState *fs, expdesc *e) {
+  LoopHoist *lh = fs->lh;
+  Instruction *use;
+  int n, h;
+  if (lh == NULL || lh->lastuse < 0)
+    return;
+  use = &fs->f->code[lh->lastuse];
+  n = GETARG_C(*use);
+  if (GET_OPCODE(*use) == OP_GETHOIST && lh->lastuse + n + 1 == fs->pc &&
+      fs->lasttarget != fs->pc &&  /* nothing jumps to the new load? */
+      GETARG_A(fs->f->code[fs->pc - 1]) == e->u.ind.t &&
+      e->u.ind.t >= ecierthonY_nvarstack(fs) &&  /* table is a temporary? */
+      (h = hoistslot(fs, lh, OP_HOISTFIELD, GETARG_B(*use), e->u.ind.idx)) >= 0) {
+    SETARG_B(*use, h);
+    SETARG_C(*use, n + 1);
   }
 }
 
+/* }====================================================== */
+
 
 /*
 ** Ensure that expression 'e' is not a variable (nor a <const>).
@@ -773,26 +898,32 @@ void ecierthonK_dischargevars (FuncState *fs, expdesc *e) {
       break;
     }
     case VINDEXUP: {
+      hoistglobal(fs, e);
       e->u.info = ecierthonK_codeABC(fs, OP_GETTABUP, 0, e->u.ind.t, e->u.ind.idx);
       e->k = VRELOC;
+      e->nt = NTANY;
       break;
     }
     case VINDEXI: {
       freereg(fs, e->u.ind.t);
       e->u.info = ecierthonK_codeABC(fs, OP_GETI, 0, e->u.ind.t, e->u.ind.idx);
       e->k = VRELOC;
+      e->nt = NTANY;
       break;
     }
     case VINDEXSTR: {
       freereg(fs, e->u.ind.t);
+      hoistfield(fs, e);
       e->u.info = ecierthonK_codeABC(fs, OP_GETFIELD, 0, e->u.ind.t, e->u.ind.idx);
       e->k = VRELOC;
+      e->nt = NTANY;
       break;
     }
     case VINDEXED: {
       freeregs(fs, e->u.ind.t, e->u.ind.idx);
       e->u.info = ecierthonK_codeABC(fs, OP_GETTABLE, 0, e->u.ind.t, e->u.ind.idx);
       e->k = VRELOC;
+      e->nt = NTANY;
       break;
     }
     case VVARARG: case VCALL: {
@@ -810,7 +941,9 @@ void ecierthonK_dischargevars (FuncState *fs, expdesc *e) {
 ** (Expression still may have jump lists.)
 */
 static void discharge2reg (FuncState *fs, expdesc *e, int reg) {
+  int nt;
   ecierthonK_dischargevars(fs, e);
+  nt = exptype(e);
   switch (e->k) {
     case VNIL: {
       ecierthonK_nil(fs, reg, 1);
@@ -856,6 +989,7 @@ static void discharge2reg (FuncState *fs, expdesc *e, int reg) {
   }
   e->u.info = reg;
   e->k = VNONRELOC;
+  e->nt = nt;
 }
 
 
@@ -899,7 +1033,9 @@ static int need_value (FuncState *fs, int list) {
 ** that do not produce values).
 */
 static void exp2reg (FuncState *fs, expdesc *e, int reg) {
+  int nt;
   discharge2reg(fs, e, reg);
+  nt = exptype(e);
   if (e->k == VJMP)  /* expression itself is a test? */
     ecierthonK_concat(fs, &e->t, e->u.info);  /* put this jump in 't' list */
   if (hasjumps(e)) {
@@ -920,6 +1056,7 @@ static void exp2reg (FuncState *fs, expdesc *e, int reg) {
   e->f = e->t = NO_JUMP;
   e->u.info = reg;
   e->k = VNONRELOC;
+  e->nt = nt;
 }
 
 
@@ -934,6 +1071,27 @@ void ecierthonK_exp2nextreg (FuncState *fs, expdesc *e) {
 }
 
 
+/*
+** Ensures final expression result is in next available register, as
+** a value of static type 'nt' (for an '<int>' or '<float>' variable):
+** numeric constants are converted when compiling; other values are
+** checked at run time, unless their static type already matches.
+*/
+void ecierthonK_exp2typed (FuncState *fs, expdesc *e, int nt) {
+  coercek(e, nt);
+  if (exptype(e) == nt)
+    ecierthonK_exp2nextreg(fs, e);
+  else {
+    int r = ecierthonK_exp2anyreg(fs, e);
+    freeexp(fs, e);
+    ecierthonK_reserveregs(fs, 1);
+    e->u.info = fs->freereg - 1;
+    ecierthonK_codeABCk(fs, OP_CHECKTYPE, e->u.info, r, 0, (nt == NTFLT));
+    e->nt = nt;
+  }
+}
+
+
 /*
 ** Ensures final expression result is in some (any) register
 ** and return that register.
@@ -1035,12 +1193,23 @@ static void codeABRK (FuncState *fs, OpCode o, int a, int b,
 void ecierthonK_storevar (FuncState *fs, expdesc *var, expdesc *ex) {
   switch (var->k) {
     case VLOCAL: {
+      coercek(ex, var->nt);
+      if (var->nt != NTANY && exptype(ex) != var->nt) {  /* check value? */
+        int e = ecierthonK_exp2anyreg(fs, ex);
+        ecierthonK_codeABCk(fs, OP_CHECKTYPE, var->u.var.sidx, e, 0,
+                                              (var->nt == NTFLT));
+        break;
+      }
       freeexp(fs, ex);
       exp2reg(fs, ex, var->u.var.sidx);  /* compute 'ex' into proper place */
       return;
     }
     case VUPVAL: {
-      int e = ecierthonK_exp2anyreg(fs, ex);
+      int e;
+      coercek(ex, var->nt);
+      if (var->nt != NTANY && exptype(ex) != var->nt)  /* check value? */
+        ecierthonK_exp2typed(fs, ex, var->nt);
+      e = ecierthonK_exp2anyreg(fs, ex);
       ecierthonK_codeABC(fs, OP_SETUPVAL, e, var->u.info, 0);
       break;
     }
@@ -1076,6 +1245,7 @@ void ecierthonK_self (FuncState *fs, expdesc *e, expdesc *key) {
   freeexp(fs, e);
   e->u.info = fs->freereg;  /* base register for op_self */
   e->k = VNONRELOC;  /* self expression has a fixed register */
+  e->nt = NTANY;
   ecierthonK_reserveregs(fs, 2);  /* function and 'self' produced by op_self */
   codeABRK(fs, OP_SELF, e->u.info, ereg, key);
   freeexp(fs, key);
@@ -1190,6 +1360,7 @@ static void codenot (FuncState *fs, expdesc *e) {
       freeexp(fs, e);
       e->u.info = ecierthonK_codeABC(fs, OP_NOT, 0, e->u.info, 0);
       e->k = VRELOC;
+      e->nt = NTANY;
       break;
     }
     default: ecierthon_assert(0);  /* cannot happen */
@@ -1423,6 +1594,61 @@ static void swapexps (expdesc *e1, expdesc *e2) {
 }
 
 
+/*
+** Static type of the result of arithmetic or bitwise operator 'opr'
+** over values with static types 'nt1' and 'nt2'.
+*/
+static int arithtype (BinOpr opr, int nt1, int nt2) {
+  if (nt1 == NTANY || nt2 == NTANY)
+    return NTANY;  /* operands may be anything, even with metamethods */
+  switch (opr) {
+    case OPR_DIV: case OPR_POW:
+      return NTFLT;
+    case OPR_BAND: case OPR_BOR: case OPR_BXOR:
+    case OPR_SHL: case OPR_SHR:
+      return NTINT;
+    default:
+      return (nt1 == NTINT && nt2 == NTINT) ? NTINT : NTFLT;
+  }
+}
+
+
+/*
+** Try to code an arithmetic operator over two '<int>' or two '<float>'
+** values in registers with a typed opcode, which needs neither tag
+** tests nor a metamethod fallback.
+*/
+static int codetyped (FuncState *fs, BinOpr opr,
+                      expdesc *e1, expdesc *e2, int line) {
+  int nt = exptype(e1);
+  int v1, v2;
+  OpCode op;
+  if (nt == NTANY || exptype(e2) != nt ||
+      tonumeral(e1, NULL) || tonumeral(e2, NULL))
+    return 0;  /* constants are better as immediate or K operands */
+  switch (opr) {
+    case OPR_ADD: op = (nt == NTINT) ? OP_ADDII : OP_ADDFF; break;
+    case OPR_SUB: op = (nt == NTINT) ? OP_SUBII : OP_SUBFF; break;
+    case OPR_MUL: op = (nt == NTINT) ? OP_MULII : OP_MULFF; break;
+    case OPR_DIV: {
+      if (nt != NTFLT)
+        return 0;
+      op = OP_DIVFF;
+      break;
+    }
+    default: return 0;
+  }
+  v2 = ecierthonK_exp2anyreg(fs, e2);
+  v1 = ecierthonK_exp2anyreg(fs, e1);
+  freeexps(fs, e1, e2);
+  e1->u.info = ecierthonK_codeABC(fs, op, 0, v1, v2);
+  e1->k = VRELOC;
+  e1->nt = nt;
+  ecierthonK_fixline(fs, line);
+  return 1;
+}
+
+
 /*
 ** Code arithmetic operators ('+', '-', ...). If second operand is a
 ** constant in the proper range, use variant opcodes with K operands.
@@ -1510,6 +1736,13 @@ static void codeorder (FuncState *fs, OpCode op, expdesc *e1, expdesc *e2) {
     op = (op == OP_LT) ? OP_GTI : OP_GEI;
   }
   else {  /* regular case, compare two registers */
+    int nt = exptype(e1);
+    if (nt != NTANY && exptype(e2) == nt) {  /* two typed values? */
+      if (nt == NTINT)
+        op = (op == OP_LT) ? OP_LTII : OP_LEII;
+      else
+        op = (op == OP_LT) ? OP_LTFF : OP_LEFF;
+    }
     r1 = ecierthonK_exp2anyreg(fs, e1);
     r2 = ecierthonK_exp2anyreg(fs, e2);
   }
@@ -1555,16 +1788,22 @@ static void codeeq (FuncState *fs, BinOpr opr, expdesc *e1, expdesc *e2) {
 ** Apply prefix operation 'op' to expression 'e'.
 */
 void ecierthonK_prefix (FuncState *fs, UnOpr op, expdesc *e, int line) {
-  static const expdesc ef = {VKINT, {0}, NO_JUMP, NO_JUMP};
+  static const expdesc ef = {VKINT, {0}, NO_JUMP, NO_JUMP, NTANY};
   ecierthonK_dischargevars(fs, e);
   switch (op) {
     case OPR_MINUS: case OPR_BNOT:  /* use 'ef' as fake 2nd operand */
       if (constfolding(fs, op + ecierthon_OPUNM, e, &ef))
         break;
       /* else */ /* FALLTHROUGH */
-    case OPR_LEN:
+    case OPR_LEN: {
+      int nt = exptype(e);
       codeunexpval(fs, cast(OpCode, op + OP_UNM), e, line);
+      if (op == OPR_LEN || nt == NTANY)
+        e->nt = NTANY;
+      else  /* '-' keeps the type; '~' always gives an integer */
+        e->nt = (op == OPR_MINUS) ? nt : NTINT;
       break;
+    }
     case OPR_NOT: codenot(fs, e); break;
     default: ecierthon_assert(0);
   }
@@ -1645,9 +1884,15 @@ static void codeconcat (FuncState *fs, expdesc *e1, expdesc *e2, int line) {
 */
 void ecierthonK_posfix (FuncState *fs, BinOpr opr,
                   expdesc *e1, expdesc *e2, int line) {
+  int nt = NTANY;  /* static type of the result */
   ecierthonK_dischargevars(fs, e2);
-  if (foldbinop(opr) && constfolding(fs, opr + ecierthon_OPADD, e1, e2))
-    return;  /* done by folding */
+  if (foldbinop(opr)) {
+    if (constfolding(fs, opr + ecierthon_OPADD, e1, e2))
+      return;  /* done by folding */
+    nt = arithtype(opr, exptype(e1), exptype(e2));
+    if (codetyped(fs, opr, e1, e2, line))
+      return;  /* done with a typed opcode */
+  }
   switch (opr) {
     case OPR_AND: {
       ecierthon_assert(e1->t == NO_JUMP);  /* list closed by 'ecierthonK_infix' */
@@ -1720,6 +1965,8 @@ void ecierthonK_posfix (FuncState *fs, BinOpr opr,
     }
     default: ecierthon_assert(0);
   }
+  if (foldbinop(opr) || opr == OPR_CONCAT)
+    e1->nt = nt;
 }
 
 
@@ -1744,6 +1991,31 @@ void ecierthonK_settablesize (FuncState *fs, int pc, int ra, int asize, int hsiz
 }
 
 
+/*
+** Replace the code of a table constructor, from its OP_NEWTABLE at
+** 'pc' to the end, by an OP_NEWTABLEK that copies template 't' into
+** register 'ra'. All
+** constants created since the constructor started ('nk' on) are only
+** used by that code, so they are removed too. Returns 0 (and changes
+** nothing) if the template's index would not fit in Bx.
+*/
+int ecierthonK_template (FuncState *fs, int pc, int ra, int nk, Table *t,
+                         int line) {
+  Proto *f = fs->f;
+  TValue o;
+  if (nk > MAXARG_Bx)
+    return 0;
+  while (fs->pc > pc)
+    removelastinstruction(fs);
+  while (fs->nk > nk)
+    setnilvalue(&f->k[--fs->nk]);
+  sethvalue(fs->ls->L, &o, t);
+  ecierthonK_codeABx(fs, OP_NEWTABLEK, ra, addk(fs, &o, &o));
+  ecierthonK_fixline(fs, line);
+  return 1;
+}
+
+
 /*
 ** Emit a SETLIST instruction.
 ** 'base' is register that keeps table;
@@ -1767,6 +2039,68 @@ void ecierthonK_setlist (FuncState *fs, int base, int nelems, int tostore) {
 }
 
 
+
+/*
+** Check whether the instruction at 'pc' (followed by a jump) is a
+** test 'R[A] == constant' that jumps when it fails, with a constant
+** that can be a table key. Returns that 'A', or -1 if it is not.
+*/
+int ecierthonK_casereg (FuncState *fs, int pc) {
+  Instruction i = fs->f->code[pc];
+  if (GETARG_k(i) != 0)  /* jumps when the values are equal? */
+    return -1;
+  else if (GET_OPCODE(i) == OP_EQI)
+    return GETARG_A(i);
+  else if (GET_OPCODE(i) == OP_EQK && !ttisnil(&fs->f->k[GETARG_B(i)]))
+    return GETARG_A(i);
+  else
+    return -1;
+}
+
+
+/*
+** Turn a chain of 'n' tests starting at 'pc', each one an instruction
+** accepted by 'ecierthonK_casereg' followed by a jump to the next test,
+** into an OP_SWITCH. Its table (a new constant) maps each test value
+** to the offset of the code after that test (the first test for a
+** value wins); the jump after the switch goes to where the last test
+** goes when it fails. The remaining tests become dead code.
+*/
+void ecierthonK_switch (FuncState *fs, int pc, int n) {
+  ecierthon_State *L = fs->ls->L;
+  Proto *f = fs->f;
+  Table *t = ecierthonH_new(L);
+  TValue key;
+  int test = pc;
+  int k;
+  sethvalue2s(L, L->top, t);  /* anchor table */
+  ecierthonD_inctop(L);
+  sethvalue(L, &key, t);
+  k = addk(fs, &key, &key);  /* table itself is the key */
+  L->top--;  /* now anchored by the prototype */
+  while (n-- > 0) {
+    Instruction i = f->code[test];
+    if (GET_OPCODE(i) == OP_EQK) {
+      setobj(L, &key, &f->k[GETARG_B(i)]);
+    }
+    else if (GETARG_C(i)) {  /* float immediate? */
+      setfltvalue(&key, cast_num(GETARG_sB(i)));
+    }
+    else {
+      setivalue(&key, GETARG_sB(i));
+    }
+    if (isempty(ecierthonH_get(t, &key))) {  /* first case with this value? */
+      TValue *slot = ecierthonH_set(L, t, &key);
+      setivalue(slot, (test + 2) - (pc + 1));
+      ecierthonC_barrierback(L, obj2gco(t), &key);
+    }
+    test = getjump(fs, test + 1);  /* go to next test */
+  }
+  f->code[pc] = CREATE_ABx(OP_SWITCH, GETARG_A(f->code[pc]), k);
+  fixjump(fs, pc + 1, test);  /* no case: go where the last test fails */
+}
+
+
 /*
 ** return the final target of a jump (skipping jumps to jumps)
 */
@@ -1783,6 +2117,22 @@ static int finaltarget (Instruction *code, int i) {
 }
 
 
+/*
+** Superinstruction doing two consecutive 'op's (see lopcodes.h). The
+** fused pairs are the most frequent ones in typical code (moving call
+** arguments, chained and sibling field accesses) whose instructions
+** do not change after this pass; instructions using upvalues still
+** may (see 'flattenupval' in lparser.c).
+*/
+static OpCode superop (OpCode op) {
+  switch (op) {
+    case OP_MOVE: return OP_MOVE2;
+    case OP_GETFIELD: return OP_GETFIELD2;
+    default: ecierthon_assert(op == OP_SETFIELD); return OP_SETFIELD2;
+  }
+}
+
+
 /*
 ** Do a final pass over the code of a function, doing small peephole
 ** optimizations and adjustments.
@@ -1812,6 +2162,13 @@ void ecierthonK_finish (FuncState *fs) {
         fixjump(fs, i, target);
         break;
       }
+      case OP_MOVE: case OP_GETFIELD: case OP_SETFIELD: {
+        if (i + 1 < fs->pc && GET_OPCODE(*(pc + 1)) == GET_OPCODE(*pc)) {
+          SET_OPCODE(*pc, superop(GET_OPCODE(*pc)));
+          i++;  /* second one stays as it is (and is not fused again) */
+        }
+        break;
+      }
       default: break;
     }
   }
@@ -75,6 +75,7 @@ ecierthonI_FUNC void ecierthonK_dischargevars (FuncState *fs, expdesc *e);
 ecierthonI_FUNC int ecierthonK_exp2anyreg (FuncState *fs, expdesc *e);
 ecierthonI_FUNC void ecierthonK_exp2anyregup (FuncState *fs, expdesc *e);
 ecierthonI_FUNC void ecierthonK_exp2nextreg (FuncState *fs, expdesc *e);
+ecierthonI_FUNC void ecierthonK_exp2typed (FuncState *fs, expdesc *e, int nt);
 ecierthonI_FUNC void ecierthonK_exp2val (FuncState *fs, expdesc *e);
 ecierthonI_FUNC int ecierthonK_exp2RK (FuncState *fs, expdesc *e);
 ecierthonI_FUNC void ecierthonK_self (FuncState *fs, expdesc *e, expdesc *key);
@@ -97,6 +98,10 @@ ecierthonI_FUNC void ecierthonK_posfix (FuncState *fs, BinOpr op, expdesc *v1,
 ecierthonI_FUNC void ecierthonK_settablesize (FuncState *fs, int pc,
                                   int ra, int asize, int hsize);
 ecierthonI_FUNC void ecierthonK_setlist (FuncState *fs, int base, int nelems, int tostore);
+ecierthonI_FUNC int ecierthonK_template (FuncState *fs, int pc, int ra, int nk,
+                                 Table *t, int line);
+ecierthonI_FUNC int ecierthonK_casereg (FuncState *fs, int pc);
+ecierthonI_FUNC void ecierthonK_switch (FuncState *fs, int pc, int n);
 ecierthonI_FUNC void ecierthonK_finish (FuncState *fs);
 ecierthonI_FUNC l_noret ecierthonK_semerror (LexState *ls, const char *msg);
 
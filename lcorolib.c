@@ -106,6 +106,33 @@ static int ecierthonB_cowrap (ecierthon_State *L) {
 }
 
 
+static int ecierthonB_poollimit (ecierthon_State *L) {
+  int limit = (int)ecierthonL_optinteger(L, 1, -1);
+  ecierthon_pushinteger(L, ecierthon_setpoollimit(L, limit));
+  return 1;
+}
+
+
+static void setstatfield (ecierthon_State *L, const char *k, size_t v) {
+  ecierthon_pushinteger(L, (ecierthon_Integer)v);
+  ecierthon_setfield(L, -2, k);
+}
+
+
+static int ecierthonB_poolstats (ecierthon_State *L) {
+  ecierthon_PoolStats s;
+  ecierthon_poolstats(L, &s);
+  ecierthon_createtable(L, 0, 6);
+  setstatfield(L, "count", s.count);
+  setstatfield(L, "limit", s.limit);
+  setstatfield(L, "reused", s.reused);
+  setstatfield(L, "created", s.created);
+  setstatfield(L, "dropped", s.dropped);
+  setstatfield(L, "collected", s.collected);
+  return 1;
+}
+
+
 static int ecierthonB_yield (ecierthon_State *L) {
   return ecierthon_yield(L, ecierthon_gettop(L));
 }
@@ -195,6 +222,8 @@ static const ecierthonL_Reg co_funcs[] = {
   {"yield", ecierthonB_yield},
   {"isyieldable", ecierthonB_yieldable},
   {"close", ecierthonB_close},
+  {"poollimit", ecierthonB_poollimit},
+  {"poolstats", ecierthonB_poolstats},
   {NULL, NULL}
 };
 
@@ -453,6 +453,28 @@ static int db_setcstacklimit (ecierthon_State *L) {
 }
 
 
+/*
+** Returns a list with the allocation sites that create old objects,
+** each one a table with fields 'source', 'line', and 'type'.
+*/
+static int db_pretenured (ecierthon_State *L) {
+  ecierthon_Debug ar;
+  int n;
+  ecierthon_newtable(L);
+  for (n = 1; ecierthon_getpretenured(L, n, &ar); n++) {
+    ecierthon_createtable(L, 0, 3);
+    ecierthon_pushstring(L, ar.short_src);
+    ecierthon_setfield(L, -2, "source");
+    ecierthon_pushinteger(L, ar.currentline);
+    ecierthon_setfield(L, -2, "line");
+    ecierthon_pushstring(L, ar.name);
+    ecierthon_setfield(L, -2, "type");
+    ecierthon_rawseti(L, -2, n);
+  }
+  return 1;
+}
+
+
 static const ecierthonL_Reg dblib[] = {
   {"debug", db_debug},
   {"getuservalue", db_getuservalue},
@@ -462,6 +484,7 @@ static const ecierthonL_Reg dblib[] = {
   {"getregistry", db_getregistry},
   {"getmetatable", db_getmetatable},
   {"getupvalue", db_getupvalue},
+  {"pretenured", db_pretenured},
   {"upvaluejoin", db_upvaluejoin},
   {"upvalueid", db_upvalueid},
   {"setuservalue", db_setuservalue},
@@ -21,8 +21,10 @@
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
+#include "lmem.h"
 #include "lobject.h"
 #include "lopcodes.h"
+#include "lopnames.h"
 #include "lstate.h"
 #include "lstring.h"
 #include "ltable.h"
@@ -161,6 +163,118 @@ ecierthon_API int ecierthon_gethookcount (ecierthon_State *L) {
 }
 
 
+/*
+** The budget counts safepoints (calls and backward jumps) run by
+** ecierthon code in thread 'L'; when it runs out, the VM calls 'func'
+** with event 'ecierthon_HOOKBUDGET' or, if 'func' is NULL, makes the
+** thread yield; where it cannot yield, the budget stays exhausted and
+** the thread yields at its next yieldable safepoint. Either way the
+** budget is off once spent. Unlike a count hook, a budget does not
+** make the VM trace instructions.
+*/
+ecierthon_API void ecierthon_setbudget (ecierthon_State *L, ecierthon_Hook func, int count) {
+  L->budgetf = func;
+  L->budget = (count > 0) ? count : MAX_LMEM;
+}
+
+
+ecierthon_API int ecierthon_getbudget (ecierthon_State *L) {
+  return (L->budget > MAX_INT) ? 0 : cast_int(L->budget);
+}
+
+
+/*
+** Ask the ecierthon code running in any thread of the state to stop at
+** its next safepoint (see 'ecierthonG_safepoint'); a 'code' of 0 cancels
+** a pending interrupt. Like 'ecierthon_sethook', this function can be
+** called during a signal or from another (OS) thread: it only stores
+** 'code' in an atomic field.
+*/
+ecierthon_API void ecierthon_interrupt (ecierthon_State *L, int code) {
+  G(L)->interrupt = code;
+}
+
+
+ecierthon_API void ecierthon_setinterrupt (ecierthon_State *L, ecierthon_Interrupt f) {
+  G(L)->interruptf = f;
+}
+
+
+#if defined(ecierthonI_OPPROFILE)
+static void resetopprofile (OpProfile *p) {
+  memset(p, 0, sizeof(OpProfile));
+  p->last = NUM_OPCODES;  /* no previous opcode */
+}
+#endif
+
+
+/*
+** Controls the opcode profiler. Counting happens in 'ecierthonV_execute'
+** only in builds with 'ecierthonI_OPPROFILE'; in other builds this
+** function returns -1. Otherwise it returns whether the profiler was
+** running (or -1 for an invalid option).
+*/
+ecierthon_API int ecierthon_opprofile (ecierthon_State *L, int what) {
+#if defined(ecierthonI_OPPROFILE)
+  global_State *g;
+  int res;
+  ecierthon_lock(L);
+  g = G(L);
+  res = g->opprofiling;
+  switch (what) {
+    case ecierthon_OPPSTOP: {
+      g->opprofiling = 0;
+      break;
+    }
+    case ecierthon_OPPSTART: {
+      if (g->opprofile == NULL) {  /* first start? */
+        g->opprofile = ecierthonM_new(L, OpProfile);
+        resetopprofile(g->opprofile);
+      }
+      g->opprofiling = 1;
+      break;
+    }
+    case ecierthon_OPPRESET: {
+      if (g->opprofile != NULL)
+        resetopprofile(g->opprofile);
+      break;
+    }
+    case ecierthon_OPPISRUNNING: break;
+    default: res = -1;  /* invalid option */
+  }
+  ecierthon_unlock(L);
+  return res;
+#else
+  UNUSED(L); UNUSED(what);
+  return -1;  /* no profiler in this build */
+#endif
+}
+
+
+/*
+** Name of opcode 'op', or NULL if there is no such opcode.
+*/
+ecierthon_API const char *ecierthon_opname (ecierthon_State *L, int op) {
+  UNUSED(L);
+  return (0 <= op && op < NUM_OPCODES) ? opnames[op] : NULL;
+}
+
+
+/*
+** Count of opcode 'op1' or, when 'op2' is a valid opcode, of the pair
+** 'op1' followed by 'op2'.
+*/
+ecierthon_API size_t ecierthon_opcount (ecierthon_State *L, int op1, int op2) {
+  OpProfile *p = G(L)->opprofile;
+  if (p == NULL || op1 < 0 || op1 >= NUM_OPCODES)
+    return 0;
+  else if (0 <= op2 && op2 < NUM_OPCODES)
+    return cast_sizet(p->pair[op1][op2]);
+  else
+    return cast_sizet(p->op[op1]);
+}
+
+
 ecierthon_API int ecierthon_getstack (ecierthon_State *L, int level, ecierthon_Debug *ar) {
   int status;
   CallInfo *ci;
@@ -257,6 +371,21 @@ ecierthon_API const char *ecierthon_setlocal (ecierthon_State *L, const eciertho
 }
 
 
+static void protoinfo (ecierthon_Debug *ar, const Proto *p) {
+  if (p->source) {
+    ar->source = getstr(p->source);
+    ar->srclen = tsslen(p->source);
+  }
+  else {
+    ar->source = "=?";
+    ar->srclen = LL("=?");
+  }
+  ar->linedefined = p->linedefined;
+  ar->lastlinedefined = p->lastlinedefined;
+  ar->what = (ar->linedefined == 0) ? "main" : "ecierthon";
+}
+
+
 static void funcinfo (ecierthon_Debug *ar, Closure *cl) {
   if (noecierthonClosure(cl)) {
     ar->source = "=[C]";
@@ -265,20 +394,8 @@ static void funcinfo (ecierthon_Debug *ar, Closure *cl) {
     ar->lastlinedefined = -1;
     ar->what = "C";
   }
-  else {
-    const Proto *p = cl->l.p;
-    if (p->source) {
-      ar->source = getstr(p->source);
-      ar->srclen = tsslen(p->source);
-    }
-    else {
-      ar->source = "=?";
-      ar->srclen = LL("=?");
-    }
-    ar->linedefined = p->linedefined;
-    ar->lastlinedefined = p->lastlinedefined;
-    ar->what = (ar->linedefined == 0) ? "main" : "ecierthon";
-  }
+  else
+    protoinfo(ar, cl->l.p);
   ecierthonO_chunkid(ar->short_src, ar->source, ar->srclen);
 }
 
@@ -414,6 +531,31 @@ ecierthon_API int ecierthon_getinfo (ecierthon_State *L, const char *what, ecier
 }
 
 
+/*
+** Get information about the n-th (starting at 1) allocation site that
+** creates old objects (see 'ecierthonC_allocsite'): the 'S' fields of
+** its function, its line in 'currentline', and the type of the objects
+** it creates in 'name'.
+*/
+ecierthon_API int ecierthon_getpretenured (ecierthon_State *L, int n, ecierthon_Debug *ar) {
+  AllocSite *s = NULL;
+  ecierthon_lock(L);
+  if (n > 0)
+    for (s = G(L)->pretenured; s != NULL && --n > 0; s = s->next) ;
+  if (s != NULL) {
+    OpCode op = GET_OPCODE(s->p->code[s->pc]);
+    protoinfo(ar, s->p);
+    ecierthonO_chunkid(ar->short_src, ar->source, ar->srclen);
+    ar->currentline = ecierthonG_getfuncline(s->p, s->pc);
+    ar->name = (op == OP_NEWTABLE || op == OP_NEWTABLEK) ? "table"
+             : (op == OP_CLOSURE) ? "function" : "string";
+    ar->namewhat = "";
+  }
+  ecierthon_unlock(L);
+  return (s != NULL);
+}
+
+
 /*
 ** {======================================================
 ** Symbolic Execution
@@ -486,7 +628,7 @@ static int findsetreg (const Proto *p, int lastpc, int reg) {
         change = (reg >= a + 2);
         break;
       }
-      case OP_CALL:
+      case OP_CALL: case OP_CALLL:
       case OP_TAILCALL: {  /* affect all registers above base */
         change = (reg >= a);
         break;
@@ -538,13 +680,13 @@ static const char *getobjname (const Proto *p, int lastpc, int reg,
     Instruction i = p->code[pc];
     OpCode op = GET_OPCODE(i);
     switch (op) {
-      case OP_MOVE: {
+      case OP_MOVE: case OP_MOVE2: {
         int b = GETARG_B(i);  /* move from 'b' to 'a' */
         if (b < GETARG_A(i))
           return getobjname(p, pc, b, name);  /* get name for 'b' */
         break;
       }
-      case OP_GETTABUP: {
+      case OP_GETTABUP: case OP_GETTABFLAT: {
         int k = GETARG_C(i);  /* key index */
         kname(p, k, name);
         return gxf(p, pc, i, 1);
@@ -558,12 +700,12 @@ static const char *getobjname (const Proto *p, int lastpc, int reg,
         *name = "integer index";
         return "field";
       }
-      case OP_GETFIELD: {
+      case OP_GETFIELD: case OP_GETFIELD2: {
         int k = GETARG_C(i);  /* key index */
         kname(p, k, name);
         return gxf(p, pc, i, 0);
       }
-      case OP_GETUPVAL: {
+      case OP_GETUPVAL: case OP_GETFLAT: {
         *name = upvalname(p, GETARG_B(i));
         return "upvalue";
       }
@@ -605,7 +747,7 @@ static const char *funcnamefromcode (ecierthon_State *L, CallInfo *ci,
     return "hook";
   }
   switch (GET_OPCODE(i)) {
-    case OP_CALL:
+    case OP_CALL: case OP_CALLL:
     case OP_TAILCALL:
       return getobjname(p, pc, GETARG_A(i), name);  /* get function name */
     case OP_TFORCALL: {  /* for iterator */
@@ -613,11 +755,12 @@ static const char *funcnamefromcode (ecierthon_State *L, CallInfo *ci,
        return "for iterator";
     }
     /* other instructions can do calls through metamethods */
-    case OP_SELF: case OP_GETTABUP: case OP_GETTABLE:
-    case OP_GETI: case OP_GETFIELD:
+    case OP_SELF: case OP_GETTABUP: case OP_GETTABFLAT: case OP_GETTABLE:
+    case OP_GETI: case OP_GETFIELD: case OP_GETFIELD2:
       tm = TM_INDEX;
       break;
-    case OP_SETTABUP: case OP_SETTABLE: case OP_SETI: case OP_SETFIELD:
+    case OP_SETTABUP: case OP_SETTABFLAT: case OP_SETTABLE:
+    case OP_SETI: case OP_SETFIELD: case OP_SETFIELD2:
       tm = TM_NEWINDEX;
       break;
     case OP_MMBIN: case OP_MMBINI: case OP_MMBINK: {
@@ -660,15 +803,16 @@ static int isinstack (CallInfo *ci, const TValue *o) {
 
 /*
 ** Checks whether value 'o' came from an upvalue. (That can only happen
-** with instructions OP_GETTABUP/OP_SETTABUP, which operate directly on
-** upvalues.)
+** with instructions OP_GETTABUP/OP_SETTABUP and their flat versions,
+** which operate directly on upvalues.)
 */
 static const char *getupvalname (CallInfo *ci, const TValue *o,
                                  const char **name) {
   LClosure *c = ci_func(ci);
   int i;
   for (i = 0; i < c->nupvalues; i++) {
-    if (c->upvals[i]->v == o) {
+    const TValue *v = isflatupval(c, i) ? &c->upvals[i].v : c->upvals[i].uv->v;
+    if (v == o) {
       *name = upvalname(c->p, i);
       return "upvalue";
     }
@@ -728,6 +872,18 @@ l_noret ecierthonG_tointerror (ecierthon_State *L, const TValue *p1, const TValu
 }
 
 
+/*
+** Error when assigning a value of the wrong type to an '<int>' or a
+** '<float>' variable
+*/
+l_noret ecierthonG_checktypeerror (ecierthon_State *L, const TValue *o, int isfloat) {
+  if (!isfloat && ttisfloat(o))  /* float without an integer value? */
+    ecierthonG_tointerror(L, o, o);
+  ecierthonG_runerror(L, "%s expected, got %s%s", isfloat ? "float" : "integer",
+                      ecierthonT_objtypename(L, o), varinfo(L, o));
+}
+
+
 l_noret ecierthonG_ordererror (ecierthon_State *L, const TValue *p1, const TValue *p2) {
   const char *t1 = ecierthonT_objtypename(L, p1);
   const char *t2 = ecierthonT_objtypename(L, p2);
@@ -850,3 +1006,67 @@ int ecierthonG_traceexec (ecierthon_State *L, const Instruction *pc) {
   return 1;  /* keep 'trap' on */
 }
 
+
+/*
+** Runs the interrupt function for an interrupt; 'currentline' carries
+** the interrupt code.
+*/
+static void interrupthook (ecierthon_State *L, ecierthon_Debug *ar) {
+  G(L)->interruptf(L, ar->currentline);
+}
+
+
+/*
+** Called by the VM at a safepoint when there is a pending interrupt
+** or the budget of 'L' runs out. 'savedpc' is the next instruction to
+** run: the target of a backward jump or the first instruction of a
+** function just called. For a jump, 'from' points after the jump
+** instruction, so that hooks and errors report its line; for a call,
+** it is NULL and they report the first line of the function. An
+** interrupt runs the interrupt function or,
+** if there is none, raises an error. An exhausted budget calls the
+** budget function or, if there is none, yields; when the thread cannot
+** yield now, the budget stays exhausted until a safepoint where it can
+** (only the main thread, which never yields, raises an error). Either
+** function can also yield; 'resume' then continues from 'savedpc', so
+** no instruction runs twice.
+*/
+void ecierthonG_safepoint (ecierthon_State *L, const Instruction *from) {
+  global_State *g = G(L);
+  CallInfo *ci = L->ci;
+  const Instruction *pc = ci->u.l.savedpc;
+  int code = g->interrupt;
+  int outofbudget = (L->budget == 0);
+  if (outofbudget)
+    L->budget = MAX_LMEM;  /* no budget until set again */
+  if (!isIT(*pc))
+    L->top = ci->top;  /* prepare top */
+  if (from == NULL) {  /* entering the function? */
+    ecierthon_assert(pc == ci_func(ci)->p->code);
+    from = pc + 1;  /* hooks and errors assume 'pc' was incremented */
+  }
+  ci->u.l.savedpc = from;
+  if (code != 0) {  /* pending interrupt? */
+    g->interrupt = 0;
+    if (g->interruptf == NULL)
+      ecierthonG_runerror(L, "interrupted (code %d)", code);
+    ecierthonD_callhook(L, interrupthook, -1, code, 0, 0);
+  }
+  if (outofbudget && L->status != ecierthon_YIELD) {
+    ecierthon_Hook f = L->budgetf;
+    if (f != NULL)
+      ecierthonD_callhook(L, f, ecierthon_HOOKBUDGET, -1, 0, 0);
+    else if (yieldable(L)) {
+      L->status = ecierthon_YIELD;
+      ci->u2.nyield = 0;  /* no results */
+    }
+    else if (L == g->mainthread)
+      ecierthonG_runerror(L, "instruction budget exhausted");
+    else
+      L->budget = 1;  /* still exhausted at the next safepoint */
+  }
+  ci->u.l.savedpc = pc;
+  if (L->status == ecierthon_YIELD)  /* yield? */
+    ecierthonD_throw(L, ecierthon_YIELD);
+}
+
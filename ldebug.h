@@ -38,6 +38,8 @@ ecierthonI_FUNC l_noret ecierthonG_concaterror (ecierthon_State *L, const TValue
 ecierthonI_FUNC l_noret ecierthonG_opinterror (ecierthon_State *L, const TValue *p1,
                                                  const TValue *p2,
                                                  const char *msg);
+ecierthonI_FUNC l_noret ecierthonG_checktypeerror (ecierthon_State *L, const TValue *o,
+                                              int isfloat);
 ecierthonI_FUNC l_noret ecierthonG_tointerror (ecierthon_State *L, const TValue *p1,
                                                  const TValue *p2);
 ecierthonI_FUNC l_noret ecierthonG_ordererror (ecierthon_State *L, const TValue *p1,
@@ -47,6 +49,7 @@ ecierthonI_FUNC const char *ecierthonG_addinfo (ecierthon_State *L, const char *
                                                   TString *src, int line);
 ecierthonI_FUNC l_noret ecierthonG_errormsg (ecierthon_State *L);
 ecierthonI_FUNC int ecierthonG_traceexec (ecierthon_State *L, const Instruction *pc);
+ecierthonI_FUNC void ecierthonG_safepoint (ecierthon_State *L, const Instruction *from);
 
 
 #endif
@@ -7,6 +7,10 @@
 #define ldo_c
 #define ecierthon_CORE
 
+#if !defined(ecierthon_USE_C89) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE  /* for anonymous mappings (ecierthon_USE_STACKRESERVE) */
+#endif
+
 #include "lprefix.h"
 
 
@@ -160,6 +164,10 @@ int ecierthonD_rawrunprotected (ecierthon_State *L, Pfunc f, void *ud) {
 ** Stack reallocation
 ** ===================================================================
 */
+/* some space for error handling */
+#define ERRORSTACKSIZE	(ecierthonI_MAXSTACK + 200)
+
+
 static void correctstack (ecierthon_State *L, StkId oldstack, StkId newstack) {
   CallInfo *ci;
   UpVal *up;
@@ -177,11 +185,11 @@ static void correctstack (ecierthon_State *L, StkId oldstack, StkId newstack) {
 }
 
 
-/* some space for error handling */
-#define ERRORSTACKSIZE	(ecierthonI_MAXSTACK + 200)
-
-
-int ecierthonD_reallocstack (ecierthon_State *L, int newsize, int raiseerror) {
+/*
+** Reallocate the stack through the allocator.
+*/
+static int reallocheapstack (ecierthon_State *L, int newsize,
+                                                 int raiseerror) {
   int lim = stacksize(L);
   StkId newstack = ecierthonM_reallocvector(L, L->stack,
                       lim + EXTRA_STACK, newsize + EXTRA_STACK, StackValue);
@@ -200,6 +208,119 @@ int ecierthonD_reallocstack (ecierthon_State *L, int newsize, int raiseerror) {
 }
 
 
+#if !defined(ecierthon_USE_STACKRESERVE)	/* { */
+
+int ecierthonD_reallocstack (ecierthon_State *L, int newsize, int raiseerror) {
+  return reallocheapstack(L, newsize, raiseerror);
+}
+
+#else				/* }{ */
+
+/*
+** The first time a stack grows, it moves to its own mapping, large
+** enough for the largest stack (ERRORSTACKSIZE) and followed by an
+** inaccessible guard page. The system provides pages when they are
+** first touched, so from then on the stack grows and shrinks in
+** place: it never moves again and there is nothing to correct. (The
+** stack checks still compare against 'stack_last', which follows the
+** size in use, because the collector traverses and clears the stack
+** up to that limit.) Stacks that never grow stay in the heap, so
+** short-lived coroutines do not pay the system calls of a mapping.
+*/
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+static size_t pagesize (void) {
+  static size_t size = 0;
+  if (size == 0)
+    size = cast_sizet(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+
+/* size of the mapping for a stack, without the guard page */
+static size_t mappedsize (void) {
+  size_t size = cast_sizet(ERRORSTACKSIZE + EXTRA_STACK) * sizeof(StackValue);
+  return (size + pagesize() - 1) & ~(pagesize() - 1);
+}
+
+
+/*
+** Move the stack to a new mapping. Returns 0 if the mapping cannot
+** be created (the caller then keeps using the heap).
+*/
+static int mapstack (ecierthon_State *L, int newsize) {
+  int lim = stacksize(L);
+  size_t size = mappedsize();
+  StkId newstack;
+  void *p = mmap(NULL, size + pagesize(), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED)
+    return 0;
+  mprotect(cast_charp(p) + size, pagesize(), PROT_NONE);  /* guard page */
+  newstack = cast(StkId, p);
+  memcpy(newstack, L->stack, (lim + EXTRA_STACK) * sizeof(StackValue));
+  for (; lim < newsize; lim++)
+    setnilvalue(s2v(newstack + lim + EXTRA_STACK)); /* erase new segment */
+  correctstack(L, L->stack, newstack);
+  ecierthonM_freearray(L, L->stack, stacksize(L) + EXTRA_STACK);
+  G(L)->GCdebt += cast(l_mem, newsize + EXTRA_STACK) * sizeof(StackValue);
+  L->stack = newstack;
+  L->stack_last = L->stack + newsize;
+  L->stackmapped = 1;
+  G(L)->resepoch++;
+  return 1;
+}
+
+
+/*
+** Resize a stack in place inside its mapping, giving back to the
+** system the pages no longer used.
+*/
+static void resizemapped (ecierthon_State *L, int newsize) {
+  int lim = stacksize(L);
+  G(L)->GCdebt += cast(l_mem, newsize - lim) * sizeof(StackValue);
+  G(L)->resepoch++;  /* stack contents live outside the allocator */
+  if (newsize < lim) {
+    size_t ps = pagesize();
+    size_t from = cast_sizet(L->stack + newsize + EXTRA_STACK);
+    size_t to = cast_sizet(L->stack + lim + EXTRA_STACK);
+    from = (from + ps - 1) & ~(ps - 1);  /* whole pages only */
+    to &= ~(ps - 1);
+    if (from < to)
+      posix_madvise(cast_voidp(from), to - from, POSIX_MADV_DONTNEED);
+  }
+  for (; lim < newsize; lim++)
+    setnilvalue(s2v(L->stack + lim + EXTRA_STACK)); /* erase new segment */
+  L->stack_last = L->stack + newsize;
+}
+
+
+int ecierthonD_reallocstack (ecierthon_State *L, int newsize, int raiseerror) {
+  ecierthon_assert(newsize <= ecierthonI_MAXSTACK || newsize == ERRORSTACKSIZE);
+  if (L->stackmapped)
+    resizemapped(L, newsize);
+  else if (newsize <= stacksize(L) || !mapstack(L, newsize))
+    return reallocheapstack(L, newsize, raiseerror);
+  return 1;
+}
+
+
+void ecierthonD_freestack (ecierthon_State *L) {
+  if (!L->stackmapped)
+    ecierthonM_freearray(L, L->stack, stacksize(L) + EXTRA_STACK);
+  else {
+    munmap(L->stack, mappedsize() + pagesize());
+    G(L)->GCdebt -= cast(l_mem, stacksize(L) + EXTRA_STACK) * sizeof(StackValue);
+    G(L)->resepoch++;
+  }
+}
+
+#endif				/* } */
+
+
 /*
 ** Try to grow the stack by at least 'n' elements. when 'raiseerror'
 ** is true, raises any error; otherwise, return 0 in case of errors.
@@ -291,37 +412,43 @@ void ecierthonD_inctop (ecierthon_State *L) {
 ** called. (Both 'L->hook' and 'L->hookmask', which trigger this
 ** function, can be changed asynchronously by signals.)
 */
+void ecierthonD_callhook (ecierthon_State *L, ecierthon_Hook hook, int event,
+                          int line, int ftransfer, int ntransfer) {
+  int mask = CIST_HOOKED;
+  CallInfo *ci = L->ci;
+  ptrdiff_t top = savestack(L, L->top);
+  ptrdiff_t ci_top = savestack(L, ci->top);
+  lu_byte allowhook = L->allowhook;
+  ecierthon_Debug ar;
+  ar.event = event;
+  ar.currentline = line;
+  ar.i_ci = ci;
+  if (ntransfer != 0) {
+    mask |= CIST_TRAN;  /* 'ci' has transfer information */
+    ci->u2.transferinfo.ftransfer = ftransfer;
+    ci->u2.transferinfo.ntransfer = ntransfer;
+  }
+  ecierthonD_checkstack(L, ecierthon_MINSTACK);  /* ensure minimum stack size */
+  if (L->top + ecierthon_MINSTACK > ci->top)
+    ci->top = L->top + ecierthon_MINSTACK;
+  L->allowhook = 0;  /* cannot call hooks inside a hook */
+  ci->callstatus |= mask;
+  ecierthon_unlock(L);
+  (*hook)(L, &ar);
+  ecierthon_lock(L);
+  ecierthon_assert(!L->allowhook);
+  L->allowhook = allowhook;
+  ci->top = restorestack(L, ci_top);
+  L->top = restorestack(L, top);
+  ci->callstatus &= ~mask;
+}
+
+
 void ecierthonD_hook (ecierthon_State *L, int event, int line,
                               int ftransfer, int ntransfer) {
   ecierthon_Hook hook = L->hook;
-  if (hook && L->allowhook) {  /* make sure there is a hook */
-    int mask = CIST_HOOKED;
-    CallInfo *ci = L->ci;
-    ptrdiff_t top = savestack(L, L->top);
-    ptrdiff_t ci_top = savestack(L, ci->top);
-    ecierthon_Debug ar;
-    ar.event = event;
-    ar.currentline = line;
-    ar.i_ci = ci;
-    if (ntransfer != 0) {
-      mask |= CIST_TRAN;  /* 'ci' has transfer information */
-      ci->u2.transferinfo.ftransfer = ftransfer;
-      ci->u2.transferinfo.ntransfer = ntransfer;
-    }
-    ecierthonD_checkstack(L, ecierthon_MINSTACK);  /* ensure minimum stack size */
-    if (L->top + ecierthon_MINSTACK > ci->top)
-      ci->top = L->top + ecierthon_MINSTACK;
-    L->allowhook = 0;  /* cannot call hooks inside a hook */
-    ci->callstatus |= mask;
-    ecierthon_unlock(L);
-    (*hook)(L, &ar);
-    ecierthon_lock(L);
-    ecierthon_assert(!L->allowhook);
-    L->allowhook = 1;
-    ci->top = restorestack(L, ci_top);
-    L->top = restorestack(L, top);
-    ci->callstatus &= ~mask;
-  }
+  if (hook && L->allowhook)  /* make sure there is a hook */
+    ecierthonD_callhook(L, hook, event, line, ftransfer, ntransfer);
 }
 
 
@@ -440,10 +567,6 @@ void ecierthonD_poscall (ecierthon_State *L, CallInfo *ci, int nres) {
 }
 
 
-
-#define next_ci(L)  (L->ci->next ? L->ci->next : ecierthonE_extendCI(L))
-
-
 /*
 ** Prepare a function for a tail call, building its call info on top
 ** of the current call info. 'narg1' is the number of arguments plus 1
@@ -502,6 +625,8 @@ CallInfo *ecierthonD_precall (ecierthon_State *L, StkId func, int nresults) {
       ecierthon_unlock(L);
       n = (*f)(L);  /* do the actual call */
       ecierthon_lock(L);
+      if (unlikely(L->status == ecierthon_YIELD))
+        return NULL;  /* yielded without a jump; 'ci' stays suspended */
       api_checknelems(L, n);
       ecierthonD_poscall(L, ci, n);
       return NULL;
@@ -588,6 +713,8 @@ static void finishCcall (ecierthon_State *L, int status) {
   ecierthon_unlock(L);
   n = (*ci->u.c.k)(L, status, ci->u.c.ctx);  /* call continuation function */
   ecierthon_lock(L);
+  if (unlikely(L->status == ecierthon_YIELD))
+    return;  /* continuation yielded again */
   api_checknelems(L, n);
   ecierthonD_poscall(L, ci, n);  /* finish 'ecierthonD_call' */
 }
@@ -596,7 +723,7 @@ static void finishCcall (ecierthon_State *L, int status) {
 /*
 ** Executes "full continuation" (everything in the stack) of a
 ** previously interrupted coroutine until the stack is empty (or another
-** interruption long-jumps out of the loop). If the coroutine is
+** interruption long-jumps or returns out of the loop). If the coroutine is
 ** recovering from an error, 'ud' points to the error status, which must
 ** be passed to the first continuation function (otherwise the default
 ** status is ecierthon_YIELD).
@@ -612,6 +739,8 @@ static void unroll (ecierthon_State *L, void *ud) {
       ecierthonV_finishOp(L);  /* finish interrupted instruction */
       ecierthonV_execute(L, ci);  /* execute down to higher C 'boundary' */
     }
+    if (L->status == ecierthon_YIELD)
+      return;  /* yielded without a jump */
   }
 }
 
@@ -683,13 +812,17 @@ static void resume (ecierthon_State *L, void *ud) {
     ecierthon_assert(L->status == ecierthon_YIELD);
     L->status = ecierthon_OK;  /* mark that it is running (again) */
     ecierthonE_incCstack(L);  /* control the C stack */
-    if (isecierthon(ci))  /* yielded inside a hook? */
+    if (isecierthon(ci)) {  /* yielded inside a hook? */
+      L->top = firstArg;  /* discard arguments */
       ecierthonV_execute(L, ci);  /* just continue running ecierthon code */
+    }
     else {  /* 'common' yield */
       if (ci->u.c.k != NULL) {  /* does it have a continuation function? */
         ecierthon_unlock(L);
         n = (*ci->u.c.k)(L, ecierthon_YIELD, ci->u.c.ctx); /* call continuation */
         ecierthon_lock(L);
+        if (unlikely(L->status == ecierthon_YIELD))
+          return;  /* continuation yielded again */
         api_checknelems(L, n);
       }
       ecierthonD_poscall(L, ci, n);  /* finish 'ecierthonD_call' */
@@ -711,6 +844,7 @@ ecierthon_API int ecierthon_resume (ecierthon_State *L, ecierthon_State *from, i
   else if (L->status != ecierthon_YIELD)  /* ended with errors? */
     return resume_error(L, "cannot resume dead coroutine", nargs);
   L->nCcalls = (from) ? getCcalls(from) : 0;
+  L->nCyield = L->nCcalls + 1;  /* level of the body (see 'ecierthon_yieldk') */
   ecierthoni_userstateresume(L, nargs);
   api_checknelems(L, (L->status == ecierthon_OK) ? nargs + 1 : nargs);
   status = ecierthonD_rawrunprotected(L, resume, &nargs);
@@ -719,8 +853,10 @@ ecierthon_API int ecierthon_resume (ecierthon_State *L, ecierthon_State *from, i
     /* unroll continuation */
     status = ecierthonD_rawrunprotected(L, unroll, &status);
   }
-  if (likely(!errorstatus(status)))
-    ecierthon_assert(status == L->status);  /* normal end or yield */
+  if (likely(!errorstatus(status))) {
+    ecierthon_assert(status == L->status || L->status == ecierthon_YIELD);
+    status = L->status;  /* normal end or yield (maybe without a jump) */
+  }
   else {  /* unrecoverable error */
     L->status = cast_byte(status);  /* mark thread as 'dead' */
     ecierthonD_seterrorobj(L, status, L->top);  /* push error message */
@@ -738,6 +874,15 @@ ecierthon_API int ecierthon_isyieldable (ecierthon_State *L) {
 }
 
 
+/*
+** A yield usually long-jumps back to 'ecierthon_resume'. When the yielding
+** C function was called by the ecierthon code that 'resume' runs directly
+** (that is, 'nCcalls' is still 'nCyield' and the call is not inside a
+** hook), there are no C frames to discard: the yield just returns, and
+** 'ecierthonD_precall', 'ecierthonV_execute', 'unroll' and 'resume' return
+** in turn when they see the status 'ecierthon_YIELD'. Either way the
+** coroutine is left in the same state.
+*/
 ecierthon_API int ecierthon_yieldk (ecierthon_State *L, int nresults, ecierthon_KContext ctx,
                         ecierthon_KFunction k) {
   CallInfo *ci;
@@ -761,7 +906,12 @@ ecierthon_API int ecierthon_yieldk (ecierthon_State *L, int nresults, ecierthon_
     if ((ci->u.c.k = k) != NULL)  /* is there a continuation? */
       ci->u.c.ctx = ctx;  /* save context */
     ci->u2.nyield = nresults;  /* save number of results */
-    ecierthonD_throw(L, ecierthon_YIELD);
+    if (L->nCcalls != L->nCyield || (ci->callstatus & CIST_HOOKED))
+      ecierthonD_throw(L, ecierthon_YIELD);
+    /* called from ecierthon code run directly by 'resume'; the C frames
+       below it return to 'ecierthon_resume' without a long jump */
+    ecierthon_unlock(L);
+    return 0;
   }
   ecierthon_assert(ci->callstatus & CIST_HOOKED);  /* must be inside a hook */
   ecierthon_unlock(L);
@@ -806,6 +956,7 @@ struct SParser {  /* data to 'f_parser' */
   Dyndata dyd;  /* dynamic structures used by the parser */
   const char *mode;
   const char *name;
+  ecierthon_Shared *shared;  /* shared block for a binary chunk */
 };
 
 
@@ -818,13 +969,33 @@ static void checkmode (ecierthon_State *L, const char *mode, const char *x) {
 }
 
 
+/*
+** Function given by loading a data-only chunk: it returns the value
+** read, which it keeps as its upvalue.
+*/
+static int dataresult (ecierthon_State *L) {
+  setobj2s(L, L->top, &clCvalue(s2v(L->ci->func))->upvalue[0]);
+  L->top++;
+  return 1;
+}
+
+
 static void f_parser (ecierthon_State *L, void *ud) {
   LClosure *cl;
   struct SParser *p = cast(struct SParser *, ud);
   int c = zgetc(p->z);  /* read first character */
   if (c == LUA_SIGNATURE[0]) {
     checkmode(L, p->mode, "binary");
-    cl = ecierthonU_undump(L, p->z, p->name);
+    cl = ecierthonU_undump(L, p->z, p->name, p->shared);
+  }
+  else if (p->mode && strchr(p->mode, 'd')) {  /* data-only chunk? */
+    CClosure *ncl;
+    ecierthonY_data(L, p->z, &p->buff, p->name, c);
+    ncl = ecierthonF_newCclosure(L, 1);
+    ncl->f = dataresult;
+    setobj2n(L, &ncl->upvalue[0], s2v(L->top - 1));
+    setclCvalue(L, s2v(L->top - 1), ncl);
+    return;
   }
   else {
     checkmode(L, p->mode, "text");
@@ -836,11 +1007,11 @@ static void f_parser (ecierthon_State *L, void *ud) {
 
 
 int ecierthonD_protectedparser (ecierthon_State *L, ZIO *z, const char *name,
-                                        const char *mode) {
+                                        const char *mode, ecierthon_Shared *shared) {
   struct SParser p;
   int status;
   incnny(L);  /* cannot yield during parsing */
-  p.z = z; p.name = name; p.mode = mode;
+  p.z = z; p.name = name; p.mode = mode; p.shared = shared;
   p.dyd.actvar.arr = NULL; p.dyd.actvar.size = 0;
   p.dyd.gt.arr = NULL; p.dyd.gt.size = 0;
   p.dyd.label.arr = NULL; p.dyd.label.size = 0;
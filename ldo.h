@@ -32,6 +32,15 @@
 
 
 
+/* free the stack of a thread */
+#if !defined(ecierthon_USE_STACKRESERVE)
+#define ecierthonD_freestack(L)  \
+	ecierthonM_freearray(L, L->stack, stacksize(L) + EXTRA_STACK)
+#else
+ecierthonI_FUNC void ecierthonD_freestack (ecierthon_State *L);
+#endif
+
+
 #define savestack(L,p)		((char *)(p) - (char *)L->stack)
 #define restorestack(L,n)	((StkId)((char *)L->stack + (n)))
 
@@ -49,12 +58,19 @@
 	ecierthonD_checkstackaux(L, (fsize), ecierthonC_checkGC(L), (void)0)
 
 
+/* get a CallInfo for a new call */
+#define next_ci(L)  (L->ci->next ? L->ci->next : ecierthonE_extendCI(L))
+
+
 /* type of protected functions, to be ran by 'runprotected' */
 typedef void (*Pfunc) (ecierthon_State *L, void *ud);
 
 ecierthonI_FUNC void ecierthonD_seterrorobj (ecierthon_State *L, int errcode, StkId oldtop);
 ecierthonI_FUNC int ecierthonD_protectedparser (ecierthon_State *L, ZIO *z, const char *name,
-                                                  const char *mode);
+                                                  const char *mode,
+                                                  ecierthon_Shared *shared);
+ecierthonI_FUNC void ecierthonD_callhook (ecierthon_State *L, ecierthon_Hook hook,
+                                 int event, int line, int fTransfer, int nTransfer);
 ecierthonI_FUNC void ecierthonD_hook (ecierthon_State *L, int event, int line,
                                         int fTransfer, int nTransfer);
 ecierthonI_FUNC void ecierthonD_hookcall (ecierthon_State *L, CallInfo *ci);
@@ -14,8 +14,11 @@
 
 #include "ecierthon.h"
 
+#include "lgc.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "ltable.h"
 #include "lundump.h"
 
 
@@ -24,6 +27,7 @@ typedef struct {
   ecierthon_Writer writer;
   void *data;
   int strip;
+  int shared;  /* omit the parts kept in a shared block? */
   int status;
 } DumpState;
 
@@ -97,37 +101,90 @@ static void dumpString (DumpState *D, const TString *s) {
 }
 
 
+/*
+** Dump the code as the compiler generated it, without the call sites
+** specialized while it ran.
+*/
 static void dumpCode (DumpState *D, const Proto *f) {
   dumpInt(D, f->sizecode);
-  dumpVector(D, f->code, f->sizecode);
+  if (!D->shared) {
+    int i;
+    for (i = 0; i < f->sizecode; i++) {
+      Instruction inst = f->code[i];
+      unspecialize(inst);
+      dumpVar(D, inst);
+    }
+  }
 }
 
 
 static void dumpFunction(DumpState *D, const Proto *f, TString *psource);
 
+static void dumpConstant (DumpState *D, const TValue *o);
+
+
+/*
+** Dump a table constant as its number of entries followed by each
+** key and value. (Such tables only contain other constants.)
+*/
+static void dumpTable (DumpState *D, Table *t) {
+  unsigned int asize = ecierthonH_realasize(t);
+  unsigned int nsize = cast_uint(sizenode(t));
+  unsigned int i;
+  int n = 0;
+  TValue key;
+  for (i = 0; i < asize; i++)
+    n += !isempty(&t->array[i]);
+  for (i = 0; i < nsize; i++)
+    n += !isempty(gval(gnode(t, i)));
+  dumpInt(D, n);
+  for (i = 0; i < asize; i++) {
+    if (!isempty(&t->array[i])) {
+      setivalue(&key, cast(ecierthon_Integer, i) + 1);
+      dumpConstant(D, &key);
+      dumpConstant(D, &t->array[i]);
+    }
+  }
+  for (i = 0; i < nsize; i++) {
+    Node *node = gnode(t, i);
+    if (!isempty(gval(node))) {
+      getnodekey(D->L, &key, node);
+      dumpConstant(D, &key);
+      dumpConstant(D, gval(node));
+    }
+  }
+}
+
+
+static void dumpConstant (DumpState *D, const TValue *o) {
+  int tt = ttypetag(o);
+  dumpByte(D, tt);
+  switch (tt) {
+    case ecierthon_VNUMFLT:
+      dumpNumber(D, fltvalue(o));
+      break;
+    case ecierthon_VNUMINT:
+      dumpInteger(D, ivalue(o));
+      break;
+    case ecierthon_VSHRSTR:
+    case ecierthon_VLNGSTR:
+      dumpString(D, tsvalue(o));
+      break;
+    case ecierthon_VTABLE:
+      dumpTable(D, hvalue(o));
+      break;
+    default:
+      ecierthon_assert(tt == ecierthon_VNIL || tt == ecierthon_VFALSE || tt == ecierthon_VTRUE);
+  }
+}
+
+
 static void dumpConstants (DumpState *D, const Proto *f) {
   int i;
   int n = f->sizek;
   dumpInt(D, n);
-  for (i = 0; i < n; i++) {
-    const TValue *o = &f->k[i];
-    int tt = ttypetag(o);
-    dumpByte(D, tt);
-    switch (tt) {
-      case ecierthon_VNUMFLT:
-        dumpNumber(D, fltvalue(o));
-        break;
-      case ecierthon_VNUMINT:
-        dumpInteger(D, ivalue(o));
-        break;
-      case ecierthon_VSHRSTR:
-      case ecierthon_VLNGSTR:
-        dumpString(D, tsvalue(o));
-        break;
-      default:
-        ecierthon_assert(tt == ecierthon_VNIL || tt == ecierthon_VFALSE || tt == ecierthon_VTRUE);
-    }
-  }
+  for (i = 0; i < n; i++)
+    dumpConstant(D, &f->k[i]);
 }
 
 
@@ -147,6 +204,7 @@ static void dumpUpvalues (DumpState *D, const Proto *f) {
     dumpByte(D, f->upvalues[i].instack);
     dumpByte(D, f->upvalues[i].idx);
     dumpByte(D, f->upvalues[i].kind);
+    dumpByte(D, f->upvalues[i].flat);
   }
 }
 
@@ -155,10 +213,11 @@ static void dumpDebug (DumpState *D, const Proto *f) {
   int i, n;
   n = (D->strip) ? 0 : f->sizelineinfo;
   dumpInt(D, n);
-  dumpVector(D, f->lineinfo, n);
+  if (!D->shared)
+    dumpVector(D, f->lineinfo, n);
   n = (D->strip) ? 0 : f->sizeabslineinfo;
   dumpInt(D, n);
-  for (i = 0; i < n; i++) {
+  for (i = 0; i < n && !D->shared; i++) {
     dumpInt(D, f->abslineinfo[i].pc);
     dumpInt(D, f->abslineinfo[i].line);
   }
@@ -208,15 +267,17 @@ static void dumpHeader (DumpState *D) {
 
 
 /*
-** dump ecierthon function as precompiled chunk
+** dump ecierthon function as precompiled chunk; a 'shared' dump omits
+** code and line information (see 'ecierthonF_share')
 */
 int ecierthonU_dump(ecierthon_State *L, const Proto *f, ecierthon_Writer w, void *data,
-              int strip) {
+              int strip, int shared) {
   DumpState D;
   D.L = L;
   D.writer = w;
   D.data = data;
   D.strip = strip;
+  D.shared = shared;
   D.status = 0;
   dumpHeader(&D);
   dumpByte(&D, f->sizeupvalues);
@@ -11,6 +11,7 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #include "ecierthon.h"
 
@@ -20,7 +21,9 @@
 #include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "lundump.h"
 
 
 
@@ -37,23 +40,30 @@ LClosure *ecierthonF_newLclosure (ecierthon_State *L, int nupvals) {
   LClosure *c = gco2lcl(o);
   c->p = NULL;
   c->nupvalues = cast_byte(nupvals);
-  while (nupvals--) c->upvals[nupvals] = NULL;
+  while (nupvals--) {
+    setnilvalue(&c->upvals[nupvals].v);  /* valid as a flat value... */
+    c->upvals[nupvals].uv = NULL;  /* ...and as an upvalue pointer */
+  }
   return c;
 }
 
 
 /*
-** fill a closure with new closed upvalues
+** fill a closure with new closed upvalues (or nil flat values)
 */
 void ecierthonF_initupvals (ecierthon_State *L, LClosure *cl) {
   int i;
   for (i = 0; i < cl->nupvalues; i++) {
-    GCObject *o = ecierthonC_newobj(L, ecierthon_VUPVAL, sizeof(UpVal));
-    UpVal *uv = gco2upv(o);
-    uv->v = &uv->u.value;  /* make it closed */
-    setnilvalue(uv->v);
-    cl->upvals[i] = uv;
-    ecierthonC_objbarrier(L, cl, uv);
+    if (isflatupval(cl, i))
+      setnilvalue(&cl->upvals[i].v);
+    else {
+      GCObject *o = ecierthonC_newobj(L, ecierthon_VUPVAL, sizeof(UpVal));
+      UpVal *uv = gco2upv(o);
+      uv->v = &uv->u.value;  /* make it closed */
+      setnilvalue(uv->v);
+      cl->upvals[i].uv = uv;
+      ecierthonC_objbarrier(L, cl, uv);
+    }
   }
 }
 
@@ -263,6 +273,12 @@ Proto *ecierthonF_newproto (ecierthon_State *L) {
   f->maxstacksize = 0;
   f->locvars = NULL;
   f->sizelocvars = 0;
+  f->sites = NULL;
+  f->sizesites = 0;
+  f->hoist = NULL;
+  f->sizehoist = 0;
+  f->shared = NULL;
+  f->cache = NULL;
   f->linedefined = 0;
   f->lastlinedefined = 0;
   f->source = NULL;
@@ -271,17 +287,140 @@ Proto *ecierthonF_newproto (ecierthon_State *L) {
 
 
 void ecierthonF_freeproto (ecierthon_State *L, Proto *f) {
-  ecierthonM_freearray(L, f->code, f->sizecode);
+  if (f->shared == NULL) {
+    ecierthonM_freearray(L, f->code, f->sizecode);
+    ecierthonM_freearray(L, f->lineinfo, f->sizelineinfo);
+    ecierthonM_freearray(L, f->abslineinfo, f->sizeabslineinfo);
+  }
+  else {  /* those parts belong to the shared block */
+    ecierthonF_unshare(f->shared);
+    G(L)->resepoch++;
+  }
   ecierthonM_freearray(L, f->p, f->sizep);
   ecierthonM_freearray(L, f->k, f->sizek);
-  ecierthonM_freearray(L, f->lineinfo, f->sizelineinfo);
-  ecierthonM_freearray(L, f->abslineinfo, f->sizeabslineinfo);
   ecierthonM_freearray(L, f->locvars, f->sizelocvars);
   ecierthonM_freearray(L, f->upvalues, f->sizeupvalues);
+  ecierthonM_freearray(L, f->hoist, f->sizehoist);
+  if (f->sites != NULL)
+    ecierthonC_freeallocsites(L, f);
   ecierthonM_free(L, f);
 }
 
 
+/*
+** {======================================================
+** Shared functions
+** =======================================================
+*/
+
+/* keep the arrays in a shared block aligned for instructions */
+#define sharedalign(n)	(((n) + sizeof(Instruction) - 1) & \
+                         ~(sizeof(Instruction) - 1))
+
+
+/*
+** Size of the shared parts of 'f' and its nested prototypes; counts
+** the prototypes in '*n'.
+*/
+static size_t sharedsize (const Proto *f, int *n) {
+  size_t size = sizeof(SharedProto) + f->sizecode * sizeof(Instruction) +
+                f->sizeabslineinfo * sizeof(AbsLineInfo) +
+                sharedalign(cast_sizet(f->sizelineinfo));
+  int i;
+  (*n)++;
+  for (i = 0; i < f->sizep; i++)
+    size += sharedsize(f->p[i], n);
+  return size;
+}
+
+
+/*
+** Copy the shared parts of 'f' and its nested prototypes into 'mem',
+** in the same order that the undump visits them. Returns the end of
+** the copied data.
+*/
+static char *fillshared (ecierthon_Shared *s, const Proto *f, int *n,
+                         char *mem) {
+  SharedProto *sp = &s->protos[(*n)++];
+  size_t size;
+  int i;
+  size = f->sizecode * sizeof(Instruction);
+  sp->code = cast(Instruction *, mem);
+  memcpy(mem, f->code, size);
+  for (i = 0; i < f->sizecode; i++)
+    unspecialize(sp->code[i]);
+  mem += size;
+  size = f->sizeabslineinfo * sizeof(AbsLineInfo);
+  sp->abslineinfo = cast(AbsLineInfo *, mem);
+  memcpy(mem, f->abslineinfo, size);
+  mem += size;
+  size = cast_sizet(f->sizelineinfo);
+  sp->lineinfo = cast(ls_byte *, mem);
+  memcpy(mem, f->lineinfo, size);
+  mem += sharedalign(size);
+  for (i = 0; i < f->sizep; i++)
+    mem = fillshared(s, f->p[i], n, mem);
+  return mem;
+}
+
+
+static int countwriter (ecierthon_State *L, const void *b, size_t size,
+                        void *ud) {
+  UNUSED(L); UNUSED(b);
+  *cast(size_t *, ud) += size;
+  return 0;
+}
+
+
+static int copywriter (ecierthon_State *L, const void *b, size_t size,
+                       void *ud) {
+  char **mem = cast(char **, ud);
+  UNUSED(L);
+  memcpy(*mem, b, size);
+  *mem += size;
+  return 0;
+}
+
+
+/*
+** Create a shared block for function 'f', with one reference (owned
+** by the caller). Returns NULL if there is no memory for it.
+*/
+ecierthon_Shared *ecierthonF_share (ecierthon_State *L, const Proto *f) {
+  global_State *g = G(L);
+  ecierthon_Shared *s;
+  size_t dumpsize = 0;
+  size_t size;
+  int n = 0;
+  char *mem;
+  size = sizeof(ecierthon_Shared) + sharedsize(f, &n);
+  ecierthonU_dump(L, f, countwriter, &dumpsize, 0, 1);
+  s = cast(ecierthon_Shared *, (*g->frealloc)(g->ud, NULL, 0, size + dumpsize));
+  if (s == NULL)
+    return NULL;
+  s->refcount = 1;
+  s->nprotos = n;
+  s->frealloc = g->frealloc;
+  s->ud = g->ud;
+  s->size = size + dumpsize;
+  s->protos = cast(SharedProto *, s + 1);
+  n = 0;
+  mem = fillshared(s, f, &n, cast_charp(s->protos + s->nprotos));
+  s->dump = mem;
+  s->dumpsize = dumpsize;
+  ecierthonU_dump(L, f, copywriter, &mem, 0, 1);
+  return s;
+}
+
+
+void ecierthonF_unshare (ecierthon_Shared *s) {
+  if (ecierthoni_atomicdec(s->refcount) == 0)
+    (*s->frealloc)(s->ud, s, s->size, 0);
+}
+
+/* }====================================================== */
+
+
 /*
 ** Look for n-th local variable at line 'line' in function 'func'.
 ** Returns NULL if not found.
@@ -15,7 +15,15 @@
                          cast_int(sizeof(TValue)) * (n))
 
 #define sizeLclosure(n)	(cast_int(offsetof(LClosure, upvals)) + \
-                         cast_int(sizeof(TValue *)) * (n))
+                         cast_int(sizeof(UpValSlot)) * (n))
+
+
+/*
+** test whether upvalue 'i' of closure 'cl' is flat. (The prototype
+** can be missing or incomplete while the closure is being built.)
+*/
+#define isflatupval(cl,i)	((cl)->p != NULL && (i) < (cl)->p->sizeupvalues \
+                                 && (cl)->p->upvalues[i].flat)
 
 
 /* test whether thread is in 'twups' list */
@@ -53,6 +61,32 @@
 #define CLOSEPROTECT	(-2)
 
 
+/*
+** Code and line information of a function and its nested functions,
+** shared by the prototypes that several states create for them
+** ('ecierthon_share'). 'protos' follows the order in which the
+** prototypes appear in 'dump', a dump of the function without those
+** parts. The block is freed with the allocator of the state that
+** created it when its reference count drops to zero.
+*/
+typedef struct SharedProto {
+  Instruction *code;
+  ls_byte *lineinfo;
+  AbsLineInfo *abslineinfo;
+} SharedProto;
+
+struct ecierthon_Shared {
+  l_uint32 refcount;
+  int nprotos;
+  ecierthon_Alloc frealloc;
+  void *ud;
+  size_t size;  /* size of the whole block */
+  SharedProto *protos;
+  const char *dump;
+  size_t dumpsize;
+};
+
+
 ecierthonI_FUNC Proto *ecierthonF_newproto (ecierthon_State *L);
 ecierthonI_FUNC CClosure *ecierthonF_newCclosure (ecierthon_State *L, int nupvals);
 ecierthonI_FUNC LClosure *ecierthonF_newLclosure (ecierthon_State *L, int nupvals);
@@ -62,6 +96,8 @@ ecierthonI_FUNC void ecierthonF_newtbcupval (ecierthon_State *L, StkId level);
 ecierthonI_FUNC int ecierthonF_close (ecierthon_State *L, StkId level, int status);
 ecierthonI_FUNC void ecierthonF_unlinkupval (UpVal *uv);
 ecierthonI_FUNC void ecierthonF_freeproto (ecierthon_State *L, Proto *f);
+ecierthonI_FUNC ecierthon_Shared *ecierthonF_share (ecierthon_State *L, const Proto *f);
+ecierthonI_FUNC void ecierthonF_unshare (ecierthon_Shared *s);
 ecierthonI_FUNC const char *ecierthonF_getlocalname (const Proto *func, int local_number,
                                          int pc);
 
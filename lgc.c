@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 
 #include "ecierthon.h"
@@ -21,6 +22,7 @@
 #include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lstring.h"
 #include "ltable.h"
@@ -46,6 +48,40 @@
 #define GCFINALIZECOST	50
 
 
+/*
+** Number of single steps between two readings of the clock in a
+** time-budgeted step. (Reading the clock costs about as much as a
+** small single step.)
+*/
+#define GCTIMECHECK	8
+
+
+/*
+** Clock for time-budgeted steps and for timing collections in adaptive
+** mode, in microseconds. POSIX systems use a monotonic clock; otherwise
+** ISO C 'clock' (processor time) is good enough, as all measured time
+** is spent inside the collector.
+*/
+#if !defined(l_gcclock)
+
+#if defined(ecierthon_USE_POSIX) && defined(CLOCK_MONOTONIC)	/* { */
+
+static l_mem l_gcclock (void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return cast(l_mem, ts.tv_sec) * 1000000 + cast(l_mem, ts.tv_nsec / 1000);
+}
+
+#else				/* }{ */
+
+#define l_gcclock()  \
+	cast(l_mem, cast(double, clock()) * (1000000.0 / CLOCKS_PER_SEC))
+
+#endif				/* } */
+
+#endif
+
+
 /*
 ** The equivalent, in bytes, of one unit of "work" (visiting a slot,
 ** sweeping an object, etc.)
@@ -333,6 +369,16 @@ static void markmt (global_State *g) {
 }
 
 
+/*
+** mark threads kept in the thread pool
+*/
+static void markthreadpool (global_State *g) {
+  int i;
+  for (i = 0; i < g->poolcount; i++)
+    markobject(g, g->threadpool[i]);
+}
+
+
 /*
 ** mark all objects in list of being-finalized
 */
@@ -399,6 +445,7 @@ static void restartcollection (global_State *g) {
   markobject(g, g->mainthread);
   markvalue(g, &g->l_registry);
   markmt(g);
+  markthreadpool(g);
   markbeingfnz(g);  /* mark any finalizing object left from previous cycle */
 }
 
@@ -571,6 +618,8 @@ static int traverseudata (global_State *g, Udata *u) {
 */
 static int traverseproto (global_State *g, Proto *f) {
   int i;
+  if (f->cache && iswhite(f->cache))
+    f->cache = NULL;  /* allow cache to be collected */
   markobjectN(g, f->source);
   for (i = 0; i < f->sizek; i++)  /* mark literals */
     markvalue(g, &f->k[i]);
@@ -580,7 +629,10 @@ static int traverseproto (global_State *g, Proto *f) {
     markobjectN(g, f->p[i]);
   for (i = 0; i < f->sizelocvars; i++)  /* mark local-variable names */
     markobjectN(g, f->locvars[i].varname);
-  return 1 + f->sizek + f->sizeupvalues + f->sizep + f->sizelocvars;
+  for (i = 0; i < f->sizehoist; i++)  /* mark hoisted values */
+    markvalue(g, &f->hoist[i]);
+  return 1 + f->sizek + f->sizeupvalues + f->sizep + f->sizelocvars +
+             f->sizehoist;
 }
 
 
@@ -592,15 +644,19 @@ static int traverseCclosure (global_State *g, CClosure *cl) {
 }
 
 /*
-** Traverse a ecierthon closure, marking its prototype and its upvalues.
-** (Both can be NULL while closure is being created.)
+** Traverse a ecierthon closure, marking its prototype and its upvalues
+** (or their values, for flat upvalues). (Both can be NULL while closure
+** is being created.)
 */
 static int traverseLclosure (global_State *g, LClosure *cl) {
   int i;
   markobjectN(g, cl->p);  /* mark its prototype */
   for (i = 0; i < cl->nupvalues; i++) {  /* visit its upvalues */
-    UpVal *uv = cl->upvals[i];
-    markobjectN(g, uv);  /* mark upvalue */
+    if (isflatupval(cl, i)) {
+      markvalue(g, &cl->upvals[i].v);
+    }
+    else
+      markobjectN(g, cl->upvals[i].uv);  /* mark upvalue */
   }
   return 1 + cl->nupvalues;
 }
@@ -761,6 +817,18 @@ static void freeupval (ecierthon_State *L, UpVal *uv) {
 }
 
 
+/*
+** Removes from the debt the external memory declared for a userdata
+** (see 'ecierthon_setexternalsize'), as that memory is about to be
+** released by its finalizer or together with the userdata itself.
+*/
+static void dropextsize (global_State *g, Udata *u) {
+  g->GCextbytes -= u->extsize;
+  g->GCdebt -= cast(l_mem, u->extsize);
+  u->extsize = 0;
+}
+
+
 static void freeobj (ecierthon_State *L, GCObject *o) {
   switch (o->tt) {
     case ecierthon_VPROTO:
@@ -787,6 +855,7 @@ static void freeobj (ecierthon_State *L, GCObject *o) {
       break;
     case ecierthon_VUSERDATA: {
       Udata *u = gco2u(o);
+      dropextsize(G(L), u);
       ecierthonM_freemem(L, o, sizeudata(u->nuvalue, u->len));
       break;
     }
@@ -822,7 +891,8 @@ static GCObject **sweeplist (ecierthon_State *L, GCObject **p, int countin,
   for (i = 0; *p != NULL && i < countin; i++) {
     GCObject *curr = *p;
     int marked = curr->marked;
-    if (isdeadm(ow, marked)) {  /* is 'curr' dead? */
+    if (isdeadm(ow, marked) &&  /* is 'curr' dead? */
+        !(curr->tt == ecierthon_VTHREAD && ecierthonE_recyclethread(g, gco2th(curr)))) {
       *p = curr->next;  /* remove 'curr' from list */
       freeobj(L, curr);  /* erase 'curr' */
     }
@@ -902,6 +972,9 @@ static void GCTM (ecierthon_State *L) {
   TValue v;
   ecierthon_assert(!g->gcemergency);
   setgcovalue(L, &v, udata2finalize(g));
+  g->resepoch++;  /* its finalizer may release external resources */
+  if (ttisfulluserdata(&v))
+    dropextsize(g, uvalue(&v));
   tm = ecierthonT_gettmbyobj(L, &v, TM_GC);
   if (!notm(tm)) {  /* is there a finalizer? */
     int status;
@@ -1028,6 +1101,7 @@ void ecierthonC_checkfinalizer (ecierthon_State *L, GCObject *o, Table *mt) {
     o->next = g->finobj;  /* link it in 'finobj' list */
     g->finobj = o;
     l_setbit(o->marked, FINALIZEDBIT);  /* mark it as such */
+    g->resepoch++;  /* 'o' may own external resources */
   }
 }
 
@@ -1043,6 +1117,186 @@ void ecierthonC_checkfinalizer (ecierthon_State *L, GCObject *o, Table *mt) {
 static void setpause (global_State *g);
 
 
+/*
+** Pretenuring. When 'g->gcpretenure' is on, the collector follows, for
+** each allocation site, one young object created there per minor
+** collection ('sample'), and counts whether it survived that
+** collection. After PTMINSAMPLES samples, a site where at least
+** PTSURVIVAL% of the samples survived starts creating its objects
+** directly as old ones, skipping the copies through survival and old1
+** ages. Counts are halved after PTMAXSAMPLES samples, to follow changes
+** in behavior. Samples are weak: they are checked after marking, before
+** any sweep, and dropped whenever the collector leaves generational
+** mode.
+*/
+#define PTMINSAMPLES	8
+#define PTMAXSAMPLES	64
+#define PTSURVIVAL	90
+
+
+/*
+** Check the samples of all sampled sites after the marking of a minor
+** collection, when dead samples are still white.
+*/
+static void checksamples (global_State *g) {
+  AllocSite *s = g->sampledsites;
+  while (s != NULL) {
+    AllocSite *next = s->next;
+    s->next = NULL;
+    s->nsamples++;
+    if (!iswhite(s->sample))
+      s->nsurvived++;
+    s->sample = NULL;
+    if (s->nsamples >= PTMINSAMPLES &&
+        s->nsurvived * 100 >= s->nsamples * PTSURVIVAL) {
+      s->pretenure = 1;
+      s->next = g->pretenured;
+      g->pretenured = s;
+    }
+    else if (s->nsamples >= PTMAXSAMPLES) {
+      s->nsamples /= 2;
+      s->nsurvived /= 2;
+    }
+    s = next;
+  }
+  g->sampledsites = NULL;
+}
+
+
+static void dropsamples (global_State *g) {
+  AllocSite *s = g->sampledsites;
+  while (s != NULL) {
+    AllocSite *next = s->next;
+    s->next = NULL;
+    s->sample = NULL;
+    s = next;
+  }
+  g->sampledsites = NULL;
+}
+
+
+static int isallocop (Instruction i) {
+  OpCode op = GET_OPCODE(i);
+  return (op == OP_NEWTABLE || op == OP_NEWTABLEK || op == OP_CLOSURE ||
+          op == OP_CONCAT);
+}
+
+
+static void createallocsites (ecierthon_State *L, Proto *p) {
+  int pc, n = 0;
+  AllocSite *sites;
+  for (pc = 0; pc < p->sizecode; pc++)
+    n += isallocop(p->code[pc]);
+  sites = ecierthonM_newvector(L, n, AllocSite);
+  for (pc = 0, n = 0; pc < p->sizecode; pc++) {
+    if (isallocop(p->code[pc])) {
+      AllocSite *s = &sites[n++];
+      s->p = p;
+      s->sample = NULL;
+      s->next = NULL;
+      s->pc = pc;
+      s->nsamples = s->nsurvived = 0;
+      s->pretenure = 0;
+    }
+  }
+  p->sites = sites;
+  p->sizesites = n;
+}
+
+
+/*
+** Binary search of the site at 'pc' ('sites' is sorted by 'pc')
+*/
+static AllocSite *findallocsite (Proto *p, int pc) {
+  int lo = 0, hi = p->sizesites - 1;
+  while (lo <= hi) {
+    int m = (lo + hi) / 2;
+    if (p->sites[m].pc < pc) lo = m + 1;
+    else if (p->sites[m].pc > pc) hi = m - 1;
+    else return &p->sites[m];
+  }
+  return NULL;
+}
+
+
+/*
+** Make a new object old and black, then restore the generational
+** invariant for what it already points to: a table (which may come
+** from a '__concat' metamethod) is handled as an old table touched by
+** a back barrier; closures, which do not use back barriers, get a
+** forward barrier for each of their references.
+*/
+static void pretenure (ecierthon_State *L, GCObject *o) {
+  o->marked = cast_byte((o->marked & ~maskgcbits) | bitmask(BLACKBIT) | G_OLD);
+  if (o->tt == ecierthon_VTABLE)
+    ecierthonC_barrierback_(L, o);
+  else if (o->tt == ecierthon_VLCL) {
+    LClosure *cl = gco2lcl(o);
+    int i;
+    ecierthonC_objbarrier(L, cl, cl->p);
+    for (i = 0; i < cl->nupvalues; i++) {
+      if (isflatupval(cl, i))
+        ecierthonC_barrier(L, cl, &cl->upvals[i].v);
+      else
+        ecierthonC_objbarrier(L, cl, cl->upvals[i].uv);
+    }
+  }
+}
+
+
+/*
+** Called by the VM with the object 'o' just created by instruction
+** 'pc' of 'p' (and anchored in the stack).
+*/
+void ecierthonC_allocsite (ecierthon_State *L, Proto *p, int pc,
+                           const TValue *o) {
+  global_State *g = G(L);
+  AllocSite *s;
+  if (!(ttisstring(o) || ttistable(o) || ttisLclosure(o)))
+    return;  /* '__concat' can create other kinds of objects */
+  if (p->sites == NULL)
+    createallocsites(L, p);  /* may run an emergency collection */
+  if (g->gckind != KGC_GEN || g->lastatomic != 0 ||
+      getage(gcvalue(o)) != G_NEW || (s = findallocsite(p, pc)) == NULL)
+    return;  /* not in (regular) generational mode or object not new */
+  if (s->pretenure)
+    pretenure(L, gcvalue(o));
+  else if (s->sample == NULL) {  /* follow this object */
+    s->sample = gcvalue(o);
+    s->next = g->sampledsites;
+    g->sampledsites = s;
+  }
+}
+
+
+/*
+** Remove the sites of a dying prototype from the 'pretenured' list and
+** free them. (No site can be sampled, as samples are dropped before
+** any sweep.)
+*/
+void ecierthonC_freeallocsites (ecierthon_State *L, Proto *p) {
+  global_State *g = G(L);
+  AllocSite **ps = &g->pretenured;
+  while (*ps != NULL) {
+    if ((*ps)->p == p)
+      *ps = (*ps)->next;  /* remove it */
+    else
+      ps = &(*ps)->next;
+  }
+  ecierthonM_freearray(L, p->sites, p->sizesites);
+  p->sites = NULL;
+  p->sizesites = 0;
+}
+
+
+void ecierthonC_setpretenure (ecierthon_State *L, int on) {
+  global_State *g = G(L);
+  if (!on)
+    dropsamples(g);
+  g->gcpretenure = cast_byte(on != 0);
+}
+
+
 /*
 ** Sweep a list of objects to enter generational mode.  Deletes dead
 ** objects and turns the non dead to old. All non-dead threads---which
@@ -1099,7 +1353,9 @@ static GCObject **sweepgen (ecierthon_State *L, global_State *g, GCObject **p,
   int white = ecierthonC_white(g);
   GCObject *curr;
   while ((curr = *p) != limit) {
-    if (iswhite(curr)) {  /* is 'curr' dead? */
+    if (iswhite(curr) &&  /* is 'curr' dead? */
+        !(curr->tt == ecierthon_VTHREAD && getage(curr) == G_NEW &&
+          ecierthonE_recyclethread(g, gco2th(curr)))) {
       ecierthon_assert(!isold(curr) && isdead(g, curr));
       *p = curr->next;  /* remove 'curr' from list */
       freeobj(L, curr);  /* erase 'curr' */
@@ -1232,6 +1488,8 @@ static void youngcollection (ecierthon_State *L, global_State *g) {
   markold(g, g->finobj, g->finobjrold);
   markold(g, g->tobefnz, NULL);
   atomic(L);
+  if (g->sampledsites != NULL)
+    checksamples(g);  /* before the sweep frees dead samples */
 
   /* sweep nursery and get a pointer to its last live element */
   g->gcstate = GCSswpallgc;
@@ -1280,6 +1538,7 @@ static void atomic2gen (ecierthon_State *L, global_State *g) {
   g->gckind = KGC_GEN;
   g->lastatomic = 0;
   g->GCestimate = gettotalbytes(g);  /* base for memory control */
+  g->GCminorbase = getheapbytes(g);
   finishgencycle(L, g);
 }
 
@@ -1306,6 +1565,7 @@ static lu_mem entergen (ecierthon_State *L, global_State *g) {
 ** and go to the pause state.
 */
 static void enterinc (global_State *g) {
+  dropsamples(g);
   whitelist(g, g->allgc);
   g->reallyold = g->old1 = g->survival = NULL;
   whitelist(g, g->finobj);
@@ -1350,6 +1610,106 @@ static void setminordebt (global_State *g) {
 }
 
 
+/*
+** In adaptive mode ('g->gcadapt' != 0, the target pause in microseconds)
+** the collector chooses between the generational and the incremental
+** modes and tunes the generational multipliers by itself:
+** - after each minor collection, 'genminormul' halves if the collection
+** took longer than the target, and grows (up to ADAPTMAXMINOR) if it
+** took less than a quarter of it;
+** - a minor collection where more than ADAPTSURVIVAL% of the young
+** memory survived, or that missed the target even with the smallest
+** nursery, counts as bad; so does each bad major collection, which
+** also raises 'genmajormul' to make major collections rarer. A good
+** minor collection clears the count;
+** - after ADAPTMAXBAD bad collections in a row, the collector switches
+** to incremental mode, and retries the generational mode after some
+** incremental cycles, waiting twice as long after each failed try.
+*/
+#define ADAPTSURVIVAL	50
+#define ADAPTMAXBAD	4
+#define ADAPTMAXMINOR	100
+#define ADAPTMAXMAJOR	1000
+#define ADAPTMAXRETRY	64
+
+
+static void adaptminor (global_State *g, lu_mem before, l_mem usecs) {
+  lu_mem after = getheapbytes(g);
+  lu_mem base = g->GCminorbase;
+  int bad = 0;
+  if (before > base) {  /* some young memory? */
+    lu_mem young = before - base;
+    lu_mem survived = (after > base) ? after - base : 0;
+    bad = (survived > (young / 100) * ADAPTSURVIVAL);
+  }
+  if (usecs > g->gcadapt) {  /* collection too long? */
+    if (g->genminormul > 1)
+      g->genminormul = cast_byte(g->genminormul / 2);  /* smaller nursery */
+    else
+      bad = 1;  /* cannot get any smaller */
+  }
+  else if (usecs < g->gcadapt / 4 && g->genminormul < ADAPTMAXMINOR) {
+    int mul = g->genminormul + g->genminormul / 4 + 1;  /* larger nursery */
+    g->genminormul = cast_byte((mul < ADAPTMAXMINOR) ? mul : ADAPTMAXMINOR);
+  }
+  g->gcadaptbad = bad ? cast_byte(g->gcadaptbad + 1) : 0;
+  g->GCminorbase = after;
+}
+
+
+static void adaptbadmajor (global_State *g) {
+  int mul = getgcparam(g->genmajormul);
+  mul += mul / 2;
+  setgcparam(g->genmajormul, (mul < ADAPTMAXMAJOR) ? mul : ADAPTMAXMAJOR);
+  if (g->gcadaptbad < ADAPTMAXBAD)
+    g->gcadaptbad++;
+}
+
+
+/*
+** Leave generational mode after too many bad collections.
+*/
+static void adapt2inc (ecierthon_State *L, global_State *g) {
+  ecierthonC_changemode(L, KGC_INC);
+  g->gcadaptbad = 0;
+  g->gcadaptcycles = g->gcadaptretry;
+  if (g->gcadaptretry < ADAPTMAXRETRY)
+    g->gcadaptretry = cast_byte(g->gcadaptretry * 2);
+  setpause(g);
+}
+
+
+/*
+** Called at the end of each incremental cycle in adaptive mode; goes
+** back to generational mode when its waiting time is over.
+*/
+static void adaptcycle (ecierthon_State *L, global_State *g) {
+  if (g->gcadaptcycles > 0)
+    g->gcadaptcycles--;
+  else {
+    ecierthonC_changemode(L, KGC_GEN);
+    setminordebt(g);
+  }
+}
+
+
+/*
+** Turns adaptive mode on, with a target pause of 'target' microseconds,
+** or off, when 'target' is zero. Adaptive mode starts in generational
+** mode.
+*/
+void ecierthonC_setadaptive (ecierthon_State *L, l_mem target) {
+  global_State *g = G(L);
+  g->gcadapt = target;
+  g->gcadaptbad = g->gcadaptcycles = 0;
+  g->gcadaptretry = 1;
+  if (target != 0 && g->gckind != KGC_GEN) {
+    ecierthonC_changemode(L, KGC_GEN);
+    setminordebt(g);
+  }
+}
+
+
 /*
 ** Does a major collection after last collection was a "bad collection".
 **
@@ -1388,6 +1748,8 @@ static void stepgenfull (ecierthon_State *L, global_State *g) {
     ecierthonC_runtilstate(L, bitmask(GCSpause));  /* finish collection */
     setpause(g);
     g->lastatomic = newatomic;
+    if (g->gcadapt != 0)
+      adaptbadmajor(g);
   }
 }
 
@@ -1427,15 +1789,313 @@ static void genstep (ecierthon_State *L, global_State *g) {
       else {  /* bad collection */
         g->lastatomic = numobjs;  /* signal that last collection was bad */
         setpause(g);  /* do a long wait for next (major) collection */
+        if (g->gcadapt != 0)
+          adaptbadmajor(g);
       }
     }
     else {  /* regular case; do a minor collection */
-      youngcollection(L, g);
+      if (g->gcadapt != 0) {
+        lu_mem before = getheapbytes(g);
+        l_mem start = l_gcclock();
+        youngcollection(L, g);
+        adaptminor(g, before, l_gcclock() - start);
+      }
+      else
+        youngcollection(L, g);
       setminordebt(g);
       g->GCestimate = majorbase;  /* preserve base value */
     }
   }
   ecierthon_assert(isdecGCmodegen(g));
+  if (g->gcadapt != 0 && g->gcadaptbad >= ADAPTMAXBAD)
+    adapt2inc(L, g);
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Heap inspection
+** =======================================================
+*/
+
+
+/*
+** Size, in bytes, of the memory block(s) owned by an object; mirrors
+** what 'freeobj' gives back to the allocator.
+*/
+static lu_mem objsize (GCObject *o) {
+  switch (o->tt) {
+    case ecierthon_VPROTO: {
+      Proto *f = gco2p(o);
+      lu_mem sz = sizeof(Proto) +
+             f->sizep * sizeof(Proto *) + f->sizek * sizeof(TValue) +
+             f->sizelocvars * sizeof(LocVar) +
+             f->sizeupvalues * sizeof(Upvaldesc) +
+             f->sizesites * sizeof(AllocSite) +
+             f->sizehoist * sizeof(TValue);
+      if (f->shared == NULL)  /* code and line info. belong to 'f'? */
+        sz += f->sizecode * sizeof(Instruction) +
+              f->sizelineinfo * sizeof(ls_byte) +
+              f->sizeabslineinfo * sizeof(AbsLineInfo);
+      return sz;
+    }
+    case ecierthon_VUPVAL: return sizeof(UpVal);
+    case ecierthon_VLCL: return sizeLclosure(gco2lcl(o)->nupvalues);
+    case ecierthon_VCCL: return sizeCclosure(gco2ccl(o)->nupvalues);
+    case ecierthon_VTABLE: {
+      Table *h = gco2t(o);
+      return sizeof(Table) + ecierthonH_realasize(h) * sizeof(TValue) +
+             allocsizenode(h) * sizeof(Node);
+    }
+    case ecierthon_VTHREAD: {
+      ecierthon_State *th = gco2th(o);
+      lu_mem sz = ecierthon_EXTRASPACE + sizeof(ecierthon_State) +
+                  th->nci * sizeof(CallInfo);
+      if (th->stack != NULL)
+        sz += (stacksize(th) + EXTRA_STACK) * sizeof(StackValue);
+      return sz;
+    }
+    case ecierthon_VUSERDATA: {
+      Udata *u = gco2u(o);
+      return sizeudata(u->nuvalue, u->len);
+    }
+    case ecierthon_VSHRSTR: return sizelstring(gco2ts(o)->shrlen);
+    case ecierthon_VLNGSTR: return sizelstring(gco2ts(o)->u.lnglen);
+    default: ecierthon_assert(0); return 0;
+  }
+}
+
+
+/*
+** During a sweep phase, lists can still contain dead objects whose
+** references may already have been freed; inspection skips them.
+*/
+#define isinspectable(g,o)	(!(issweepphase(g) && isdead(g, o)))
+
+
+static void censuslist (global_State *g, GCObject *o, ecierthon_Census *c) {
+  for (; o != NULL; o = o->next) {
+    if (isinspectable(g, o)) {
+      int t = novariant(o->tt);
+      lu_mem sz = objsize(o);
+      c->count[t]++;
+      c->bytes[t] += sz;
+      if (o->tt == ecierthon_VTABLE) {
+        Table *h = gco2t(o);
+        unsigned int slots = ecierthonH_realasize(h) + allocsizenode(h);
+        int b = (slots == 0) ? 0 : ecierthonO_ceillog2(slots);
+        if (b >= ecierthon_CENSUSBUCKETS)
+          b = ecierthon_CENSUSBUCKETS - 1;
+        c->tcount[b]++;
+        c->tbytes[b] += sz;
+      }
+    }
+  }
+}
+
+
+/*
+** Counts objects and bytes per type, and tables per size bucket.
+** Bucket 'b' holds tables with at most 2^b slots (and more than
+** 2^(b-1)); bucket 0 holds tables with at most one slot. Does not
+** allocate.
+*/
+void ecierthonC_census (ecierthon_State *L, ecierthon_Census *c) {
+  global_State *g = G(L);
+  memset(c, 0, sizeof(*c));
+  censuslist(g, g->allgc, c);
+  censuslist(g, g->finobj, c);
+  censuslist(g, g->tobefnz, c);
+  censuslist(g, g->fixedgc, c);
+}
+
+
+typedef struct {
+  ecierthon_State *L;
+  ecierthon_Writer writer;
+  void *data;
+  int status;
+  int nrefs;  /* number of references written for current object */
+  size_t n;  /* number of chars in 'buff' */
+  char buff[ecierthon_IDSIZE * 4];
+} SnapState;
+
+
+static void snapflush (SnapState *S) {
+  if (S->status == 0 && S->n > 0) {
+    ecierthon_unlock(S->L);
+    S->status = (*S->writer)(S->L, S->buff, S->n, S->data);
+    ecierthon_lock(S->L);
+  }
+  S->n = 0;
+}
+
+
+static void snapstr (SnapState *S, const char *s) {
+  for (; *s != '\0'; s++) {
+    if (S->n == sizeof(S->buff))
+      snapflush(S);
+    S->buff[S->n++] = *s;
+  }
+}
+
+
+static void snapsize (SnapState *S, lu_mem x) {
+  char b[ecierthon_IDSIZE];
+  l_sprintf(b, sizeof(b), "%lu", cast(unsigned long, x));
+  snapstr(S, b);
+}
+
+
+static void snapref (SnapState *S, GCObject *o) {
+  char b[ecierthon_IDSIZE];
+  if (o == NULL)
+    return;
+  ecierthon_pointer2str(b, sizeof(b), o);
+  snapstr(S, (S->nrefs++ == 0) ? "\"" : ",\"");
+  snapstr(S, b);
+  snapstr(S, "\"");
+}
+
+
+#define snapvalue(S,v)	snapref(S, gcvalueN(v))
+
+/* reference to an object that may be NULL ('obj2gco' cannot take NULL) */
+#define snapobj(S,o)	snapref(S, (o) ? obj2gco(o) : NULL)
+
+
+/*
+** Writes the references of an object, in the order the collector
+** would traverse them.
+*/
+static void snaprefs (SnapState *S, GCObject *o) {
+  int i;
+  switch (o->tt) {
+    case ecierthon_VTABLE: {
+      Table *h = gco2t(o);
+      unsigned int asize = ecierthonH_realasize(h);
+      Node *n, *limit = gnodelast(h);
+      snapobj(S, h->metatable);
+      for (i = 0; cast_uint(i) < asize; i++)
+        snapvalue(S, &h->array[i]);
+      for (n = gnode(h, 0); n < limit; n++) {
+        if (!isempty(gval(n))) {
+          if (keyiscollectable(n))
+            snapref(S, gckey(n));
+          snapvalue(S, gval(n));
+        }
+      }
+      break;
+    }
+    case ecierthon_VUSERDATA: {
+      Udata *u = gco2u(o);
+      snapobj(S, u->metatable);
+      for (i = 0; i < u->nuvalue; i++)
+        snapvalue(S, &u->uv[i].uv);
+      break;
+    }
+    case ecierthon_VLCL: {
+      LClosure *cl = gco2lcl(o);
+      snapobj(S, cl->p);
+      for (i = 0; i < cl->nupvalues; i++) {
+        if (isflatupval(cl, i))
+          snapvalue(S, &cl->upvals[i].v);
+        else
+          snapobj(S, cl->upvals[i].uv);
+      }
+      break;
+    }
+    case ecierthon_VCCL: {
+      CClosure *cl = gco2ccl(o);
+      for (i = 0; i < cl->nupvalues; i++)
+        snapvalue(S, &cl->upvalue[i]);
+      break;
+    }
+    case ecierthon_VPROTO: {
+      Proto *f = gco2p(o);
+      snapobj(S, f->source);
+      for (i = 0; i < f->sizek; i++)
+        snapvalue(S, &f->k[i]);
+      for (i = 0; i < f->sizeupvalues; i++)
+        snapobj(S, f->upvalues[i].name);
+      for (i = 0; i < f->sizep; i++)
+        snapobj(S, f->p[i]);
+      for (i = 0; i < f->sizelocvars; i++)
+        snapobj(S, f->locvars[i].varname);
+      for (i = 0; i < f->sizehoist; i++)
+        snapvalue(S, &f->hoist[i]);
+      break;
+    }
+    case ecierthon_VTHREAD: {
+      ecierthon_State *th = gco2th(o);
+      StkId sv;
+      if (th->stack != NULL) {
+        for (sv = th->stack; sv < th->top; sv++)
+          snapvalue(S, s2v(sv));
+      }
+      break;
+    }
+    case ecierthon_VUPVAL: {
+      snapvalue(S, gco2upv(o)->v);
+      break;
+    }
+    default: break;  /* strings have no references */
+  }
+}
+
+
+static void snaplist (SnapState *S, GCObject *o, int *first) {
+  global_State *g = G(S->L);
+  char b[ecierthon_IDSIZE];
+  for (; o != NULL && S->status == 0; o = o->next) {
+    if (isinspectable(g, o)) {
+      ecierthon_pointer2str(b, sizeof(b), o);
+      snapstr(S, (*first) ? "\n{\"id\":\"" : ",\n{\"id\":\"");
+      *first = 0;
+      snapstr(S, b);
+      snapstr(S, "\",\"type\":\"");
+      snapstr(S, ttypename(novariant(o->tt)));
+      snapstr(S, "\",\"size\":");
+      snapsize(S, objsize(o));
+      snapstr(S, ",\"refs\":[");
+      S->nrefs = 0;
+      snaprefs(S, o);
+      snapstr(S, "]}");
+    }
+  }
+}
+
+
+/*
+** Writes a heap graph as a JSON document: an object with a field
+** "objects", an array of records '{"id", "type", "size", "refs"}',
+** one per line, where 'refs' lists the ids of all collectable objects
+** each object points to. The collector is kept from running while the
+** snapshot is written, so the writer must not create new objects.
+*/
+int ecierthonC_snapshot (ecierthon_State *L, ecierthon_Writer writer,
+                         void *data) {
+  global_State *g = G(L);
+  lu_byte oldrunning = g->gcrunning;
+  int first = 1;
+  SnapState S;
+  S.L = L;
+  S.writer = writer;
+  S.data = data;
+  S.status = 0;
+  S.n = 0;
+  g->gcrunning = 0;  /* keep lists stable */
+  snapstr(&S, "{\"format\":\"ecierthon-heap\",\"version\":1,\"objects\":[");
+  snaplist(&S, g->allgc, &first);
+  snaplist(&S, g->finobj, &first);
+  snaplist(&S, g->tobefnz, &first);
+  snaplist(&S, g->fixedgc, &first);
+  snapstr(&S, "\n]}\n");
+  snapflush(&S);
+  g->gcrunning = oldrunning;
+  return S.status;
 }
 
 /* }====================================================== */
@@ -1526,6 +2186,7 @@ static lu_mem atomic (ecierthon_State *L) {
   /* registry and global metatables may be changed by API */
   markvalue(g, &g->l_registry);
   markmt(g);  /* mark global metatables */
+  markthreadpool(g);  /* pool may have changed since last marking */
   work += propagateall(g);  /* empties 'gray' list */
   /* remark occasional upvalues of (maybe) dead threads */
   work += remarkupvals(g);
@@ -1652,14 +2313,56 @@ static void incstep (ecierthon_State *L, global_State *g) {
     lu_mem work = singlestep(L);  /* perform one single step */
     debt -= work;
   } while (debt > -stepsize && g->gcstate != GCSpause);
-  if (g->gcstate == GCSpause)
+  if (g->gcstate == GCSpause) {
     setpause(g);  /* pause until next cycle */
+    if (g->gcadapt != 0)
+      adaptcycle(L, g);
+  }
   else {
     debt = (debt / stepmul) * WORK2MEM;  /* convert 'work units' to bytes */
     ecierthonE_setdebt(g, debt);
   }
 }
 
+/*
+** Performs incremental work until the time budget 'usecs' (in
+** microseconds) runs out or the current cycle finishes. The work done
+** is credited to the debt, so that idle-time collection postpones
+** the next automatic step. In generational mode a step is an
+** indivisible minor collection, so the budget only decides that one
+** is done. Returns true if the step finished a cycle.
+*/
+int ecierthonC_steptime (ecierthon_State *L, l_mem usecs) {
+  global_State *g = G(L);
+  ecierthon_assert(!g->gcemergency);
+  if (isdecGCmodegen(g)) {
+    ecierthonE_setdebt(g, 0);
+    genstep(L, g);
+    return 1;
+  }
+  else {
+    int stepmul = (getgcparam(g->gcstepmul) | 1);  /* avoid division by 0 */
+    l_mem debt = (g->GCdebt / WORK2MEM) * stepmul;
+    l_mem deadline = l_gcclock() + usecs;
+    int n = 0;
+    do {
+      debt -= singlestep(L);
+    } while (g->gcstate != GCSpause &&
+             (++n % GCTIMECHECK != 0 || l_gcclock() < deadline));
+    if (g->gcstate == GCSpause) {
+      setpause(g);  /* pause until next cycle */
+      if (g->gcadapt != 0)
+        adaptcycle(L, g);
+      return 1;
+    }
+    else {
+      ecierthonE_setdebt(g, (debt / stepmul) * WORK2MEM);
+      return 0;
+    }
+  }
+}
+
+
 /*
 ** performs a basic GC step if collector is running
 */
@@ -177,6 +177,7 @@
 ecierthonI_FUNC void ecierthonC_fix (ecierthon_State *L, GCObject *o);
 ecierthonI_FUNC void ecierthonC_freeallobjects (ecierthon_State *L);
 ecierthonI_FUNC void ecierthonC_step (ecierthon_State *L);
+ecierthonI_FUNC int ecierthonC_steptime (ecierthon_State *L, l_mem usecs);
 ecierthonI_FUNC void ecierthonC_runtilstate (ecierthon_State *L, int statesmask);
 ecierthonI_FUNC void ecierthonC_fullgc (ecierthon_State *L, int isemergency);
 ecierthonI_FUNC GCObject *ecierthonC_newobj (ecierthon_State *L, int tt, size_t sz);
@@ -184,6 +185,14 @@ ecierthonI_FUNC void ecierthonC_barrier_ (ecierthon_State *L, GCObject *o, GCObj
 ecierthonI_FUNC void ecierthonC_barrierback_ (ecierthon_State *L, GCObject *o);
 ecierthonI_FUNC void ecierthonC_checkfinalizer (ecierthon_State *L, GCObject *o, Table *mt);
 ecierthonI_FUNC void ecierthonC_changemode (ecierthon_State *L, int newmode);
+ecierthonI_FUNC void ecierthonC_setadaptive (ecierthon_State *L, l_mem target);
+ecierthonI_FUNC void ecierthonC_setpretenure (ecierthon_State *L, int on);
+ecierthonI_FUNC void ecierthonC_allocsite (ecierthon_State *L, Proto *p, int pc,
+                                           const TValue *o);
+ecierthonI_FUNC void ecierthonC_freeallocsites (ecierthon_State *L, Proto *p);
+ecierthonI_FUNC void ecierthonC_census (ecierthon_State *L, ecierthon_Census *c);
+ecierthonI_FUNC int ecierthonC_snapshot (ecierthon_State *L, ecierthon_Writer writer,
+                                         void *data);
 
 
 #endif
@@ -209,6 +209,7 @@ static int aux_close (ecierthon_State *L) {
   LStream *p = tolstream(L);
   volatile ecierthon_CFunction cf = p->closef;
   p->closef = NULL;  /* mark stream as closed */
+  ecierthon_setexternalsize(L, 1, 0);  /* its buffer goes away */
   return (*cf)(L);  /* close it */
 }
 
@@ -234,6 +235,13 @@ static int f_gc (ecierthon_State *L) {
 }
 
 
+/*
+** Opened streams declare their buffer as external memory; that also
+** lets arena states see them (see 'ecierthonL_resetstate').
+*/
+#define setbufsize(L)	ecierthon_setexternalsize(L, -1, BUFSIZ)
+
+
 /*
 ** function to close regular files
 */
@@ -248,6 +256,7 @@ static LStream *newfile (ecierthon_State *L) {
   LStream *p = newprefile(L);
   p->f = NULL;
   p->closef = &io_fclose;
+  setbufsize(L);
   return p;
 }
 
@@ -288,6 +297,7 @@ static int io_popen (ecierthon_State *L) {
   ecierthonL_argcheck(L, l_checkmodep(mode), 2, "invalid mode");
   p->f = l_popen(L, filename, mode);
   p->closef = &io_pclose;
+  setbufsize(L);
   return (p->f == NULL) ? ecierthonL_fileresult(L, 0, filename) : 1;
 }
 
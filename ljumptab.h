@@ -26,6 +26,8 @@ static const void *const disptab[NUM_OPCODES] = {
 #endif
 
 &&L_OP_MOVE,
+&&L_OP_MOVE2,
+&&L_OP_CHECKTYPE,
 &&L_OP_LOADI,
 &&L_OP_LOADF,
 &&L_OP_LOADK,
@@ -36,15 +38,21 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_LOADNIL,
 &&L_OP_GETUPVAL,
 &&L_OP_SETUPVAL,
+&&L_OP_GETFLAT,
 &&L_OP_GETTABUP,
+&&L_OP_GETTABFLAT,
 &&L_OP_GETTABLE,
 &&L_OP_GETI,
 &&L_OP_GETFIELD,
+&&L_OP_GETFIELD2,
 &&L_OP_SETTABUP,
+&&L_OP_SETTABFLAT,
 &&L_OP_SETTABLE,
 &&L_OP_SETI,
 &&L_OP_SETFIELD,
+&&L_OP_SETFIELD2,
 &&L_OP_NEWTABLE,
+&&L_OP_NEWTABLEK,
 &&L_OP_SELF,
 &&L_OP_ADDI,
 &&L_OP_ADDK,
@@ -71,6 +79,13 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_BXOR,
 &&L_OP_SHL,
 &&L_OP_SHR,
+&&L_OP_ADDII,
+&&L_OP_SUBII,
+&&L_OP_MULII,
+&&L_OP_ADDFF,
+&&L_OP_SUBFF,
+&&L_OP_MULFF,
+&&L_OP_DIVFF,
 &&L_OP_MMBIN,
 &&L_OP_MMBINI,
 &&L_OP_MMBINK,
@@ -82,6 +97,7 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_CLOSE,
 &&L_OP_TBC,
 &&L_OP_JMP,
+&&L_OP_SWITCH,
 &&L_OP_EQ,
 &&L_OP_LT,
 &&L_OP_LE,
@@ -91,21 +107,32 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_LEI,
 &&L_OP_GTI,
 &&L_OP_GEI,
+&&L_OP_LTII,
+&&L_OP_LEII,
+&&L_OP_LTFF,
+&&L_OP_LEFF,
 &&L_OP_TEST,
 &&L_OP_TESTSET,
 &&L_OP_CALL,
+&&L_OP_CALLL,
 &&L_OP_TAILCALL,
 &&L_OP_RETURN,
 &&L_OP_RETURN0,
 &&L_OP_RETURN1,
 &&L_OP_FORLOOP,
 &&L_OP_FORPREP,
+&&L_OP_FORPREPH,
+&&L_OP_HOISTUP,
+&&L_OP_HOISTFIELD,
+&&L_OP_HOISTDONE,
+&&L_OP_GETHOIST,
 &&L_OP_TFORPREP,
 &&L_OP_TFORCALL,
 &&L_OP_TFORLOOP,
 &&L_OP_SETLIST,
 &&L_OP_CLOSURE,
 &&L_OP_VARARG,
+&&L_OP_SELECT,
 &&L_OP_VARARGPREP,
 &&L_OP_EXTRAARG
 
@@ -263,6 +263,21 @@ typedef l_uint32 Instruction;
 #endif
 
 
+/*
+** macros to increment/decrement (returning the new value) reference
+** counts of data shared by states that may run in different threads
+*/
+#if !defined(ecierthoni_atomicinc)
+#if defined(__GNUC__)
+#define ecierthoni_atomicinc(x)	__atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED)
+#define ecierthoni_atomicdec(x)	__atomic_sub_fetch(&(x), 1, __ATOMIC_ACQ_REL)
+#else
+#define ecierthoni_atomicinc(x)	(++(x))
+#define ecierthoni_atomicdec(x)	(--(x))
+#endif
+#endif
+
+
 /*
 ** these macros allow user-specific actions when a thread is
 ** created/deleted/resumed/yielded.
@@ -440,6 +440,7 @@ typedef struct Udata {
   CommonHeader;
   unsigned short nuvalue;  /* number of user values */
   size_t len;  /* number of bytes */
+  size_t extsize;  /* external bytes accounted to the collector */
   struct Table *metatable;
   GCObject *gclist;
   UValue uv[1];  /* user values */
@@ -459,6 +460,7 @@ typedef struct Udata0 {
   CommonHeader;
   unsigned short nuvalue;  /* number of user values */
   size_t len;  /* number of bytes */
+  size_t extsize;  /* external bytes accounted to the collector */
   struct Table *metatable;
   union {ecierthonI_MAXALIGN;} bindata;
 } Udata0;
@@ -495,6 +497,8 @@ typedef struct Upvaldesc {
   lu_byte instack;  /* whether it is in stack (register) */
   lu_byte idx;  /* index of upvalue (in stack or in outer function's list) */
   lu_byte kind;  /* kind of corresponding variable */
+  lu_byte flat;  /* whether closures hold a copy of the value */
+  lu_byte nt;  /* numeric type of corresponding variable (parser only) */
 } Upvaldesc;
 
 
@@ -524,6 +528,22 @@ typedef struct AbsLineInfo {
   int line;
 } AbsLineInfo;
 
+/*
+** Allocation site: an instruction that creates objects (OP_NEWTABLE,
+** OP_CLOSURE, or OP_CONCAT), tracked for pretenuring in generational
+** mode (see 'ecierthonC_allocsite')
+*/
+typedef struct AllocSite {
+  struct Proto *p;  /* function containing the site */
+  GCObject *sample;  /* young object being followed (or NULL) */
+  struct AllocSite *next;  /* next site in a 'sampled'/'pretenured' list */
+  int pc;  /* index of the instruction */
+  unsigned short nsamples;  /* number of objects followed */
+  unsigned short nsurvived;  /* followed objects that survived */
+  lu_byte pretenure;  /* true if site creates old objects */
+} AllocSite;
+
+
 /*
 ** Function Prototypes
 */
@@ -539,6 +559,8 @@ typedef struct Proto {
   int sizep;  /* size of 'p' */
   int sizelocvars;
   int sizeabslineinfo;  /* size of 'abslineinfo' */
+  int sizesites;  /* size of 'sites' */
+  int sizehoist;  /* size of 'hoist' */
   int linedefined;  /* debug information  */
   int lastlinedefined;  /* debug information  */
   TValue *k;  /* constants used by the function */
@@ -548,6 +570,10 @@ typedef struct Proto {
   ls_byte *lineinfo;  /* information about source lines (debug information) */
   AbsLineInfo *abslineinfo;  /* idem */
   LocVar *locvars;  /* information about local variables (debug information) */
+  AllocSite *sites;  /* allocation sites (created on demand) */
+  TValue *hoist;  /* values hoisted out of loops (created on demand) */
+  struct ecierthon_Shared *shared;  /* owner of 'code' and line info. (or NULL) */
+  struct LClosure *cache;  /* last-created closure with this prototype */
   TString  *source;  /* used for debug information */
   GCObject *gclist;
 } Proto;
@@ -628,10 +654,21 @@ typedef struct CClosure {
 } CClosure;
 
 
+/*
+** Upvalue of a ecierthon closure: a pointer to an 'UpVal' or, for a
+** flat upvalue (a variable that is never assigned after its
+** initialization), a copy of the value itself
+*/
+typedef union UpValSlot {
+  UpVal *uv;
+  TValue v;
+} UpValSlot;
+
+
 typedef struct LClosure {
   ClosureHeader;
   struct Proto *p;
-  UpVal *upvals[1];  /* list of upvalues */
+  UpValSlot upvals[1];  /* list of upvalues */
 } LClosure;
 
 
@@ -710,6 +747,11 @@ typedef union Node {
 #define setrealasize(t)		((t)->flags &= cast_byte(~BITRAS))
 #define setnorealasize(t)	((t)->flags |= BITRAS)
 
+/* bit for tables read by hoisted loop loads (see OP_HOISTUP) */
+#define BITWATCH	(1 << 6)
+#define iswatched(t)		((t)->flags & BITWATCH)
+#define setwatched(t)		((t)->flags |= BITWATCH)
+
 
 typedef struct Table {
   CommonHeader;
@@ -18,6 +18,8 @@
 ecierthonI_DDEF const lu_byte ecierthonP_opmodes[NUM_OPCODES] = {
 /*       MM OT IT T  A  mode		   opcode  */
   opmode(0, 0, 0, 0, 1, iABC)		/* OP_MOVE */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_MOVE2 */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_CHECKTYPE */
  ,opmode(0, 0, 0, 0, 1, iAsBx)		/* OP_LOADI */
  ,opmode(0, 0, 0, 0, 1, iAsBx)		/* OP_LOADF */
  ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_LOADK */
@@ -28,15 +30,21 @@ ecierthonI_DDEF const lu_byte ecierthonP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_LOADNIL */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETUPVAL */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETUPVAL */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETFLAT */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETTABUP */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETTABFLAT */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETTABLE */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETI */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETFIELD */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GETFIELD2 */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETTABUP */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETTABFLAT */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETTABLE */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETI */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETFIELD */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SETFIELD2 */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_NEWTABLE */
+ ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_NEWTABLEK */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SELF */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_ADDI */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_ADDK */
@@ -63,6 +71,13 @@ ecierthonI_DDEF const lu_byte ecierthonP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_BXOR */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SHL */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SHR */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_ADDII */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SUBII */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_MULII */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_ADDFF */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_SUBFF */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_MULFF */
+ ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_DIVFF */
  ,opmode(1, 0, 0, 0, 0, iABC)		/* OP_MMBIN */
  ,opmode(1, 0, 0, 0, 0, iABC)		/* OP_MMBINI*/
  ,opmode(1, 0, 0, 0, 0, iABC)		/* OP_MMBINK*/
@@ -74,6 +89,7 @@ ecierthonI_DDEF const lu_byte ecierthonP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_CLOSE */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_TBC */
  ,opmode(0, 0, 0, 0, 0, isJ)		/* OP_JMP */
+ ,opmode(0, 0, 0, 0, 0, iABx)		/* OP_SWITCH */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_EQ */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LT */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LE */
@@ -83,21 +99,32 @@ ecierthonI_DDEF const lu_byte ecierthonP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LEI */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_GTI */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_GEI */
+ ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LTII */
+ ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LEII */
+ ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LTFF */
+ ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_LEFF */
  ,opmode(0, 0, 0, 1, 0, iABC)		/* OP_TEST */
  ,opmode(0, 0, 0, 1, 1, iABC)		/* OP_TESTSET */
  ,opmode(0, 1, 1, 0, 1, iABC)		/* OP_CALL */
+ ,opmode(0, 1, 1, 0, 1, iABC)		/* OP_CALLL */
  ,opmode(0, 1, 1, 0, 1, iABC)		/* OP_TAILCALL */
  ,opmode(0, 0, 1, 0, 0, iABC)		/* OP_RETURN */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_RETURN0 */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_RETURN1 */
  ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_FORLOOP */
  ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_FORPREP */
+ ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_FORPREPH */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_HOISTUP */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_HOISTFIELD */
+ ,opmode(0, 0, 0, 0, 0, iABx)		/* OP_HOISTDONE */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_GETHOIST */
  ,opmode(0, 0, 0, 0, 0, iABx)		/* OP_TFORPREP */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_TFORCALL */
  ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_TFORLOOP */
  ,opmode(0, 0, 1, 0, 0, iABC)		/* OP_SETLIST */
  ,opmode(0, 0, 0, 0, 1, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, 0, 0, 1, iABC)		/* OP_VARARG */
+ ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_SELECT */
  ,opmode(0, 0, 1, 0, 1, iABC)		/* OP_VARARGPREP */
  ,opmode(0, 0, 0, 0, 0, iAx)		/* OP_EXTRAARG */
 };
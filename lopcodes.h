@@ -198,6 +198,8 @@ typedef enum {
   name		args	description
 ------------------------------------------------------------------------*/
 OP_MOVE,/*	A B	R[A] := R[B]					*/
+OP_MOVE2,/*	A B	R[A] := R[B]; then the next OP_MOVE		*/
+OP_CHECKTYPE,/*	A B k	R[A] := R[B] as an integer (k=0) or a float (k=1) */
 OP_LOADI,/*	A sBx	R[A] := sBx					*/
 OP_LOADF,/*	A sBx	R[A] := (ecierthon_Number)sBx				*/
 OP_LOADK,/*	A Bx	R[A] := K[Bx]					*/
@@ -208,18 +210,24 @@ OP_LOADTRUE,/*	A	R[A] := true					*/
 OP_LOADNIL,/*	A B	R[A], R[A+1], ..., R[A+B] := nil		*/
 OP_GETUPVAL,/*	A B	R[A] := UpValue[B]				*/
 OP_SETUPVAL,/*	A B	UpValue[B] := R[A]				*/
+OP_GETFLAT,/*	A B	R[A] := FlatUpValue[B]				*/
 
 OP_GETTABUP,/*	A B C	R[A] := UpValue[B][K[C]:string]			*/
+OP_GETTABFLAT,/*A B C	R[A] := FlatUpValue[B][K[C]:string]		*/
 OP_GETTABLE,/*	A B C	R[A] := R[B][R[C]]				*/
 OP_GETI,/*	A B C	R[A] := R[B][C]					*/
 OP_GETFIELD,/*	A B C	R[A] := R[B][K[C]:string]			*/
+OP_GETFIELD2,/*A B C	R[A] := R[B][K[C]:string]; then the next OP_GETFIELD */
 
 OP_SETTABUP,/*	A B C	UpValue[A][K[B]:string] := RK(C)		*/
+OP_SETTABFLAT,/*A B C	FlatUpValue[A][K[B]:string] := RK(C)		*/
 OP_SETTABLE,/*	A B C	R[A][R[B]] := RK(C)				*/
 OP_SETI,/*	A B C	R[A][B] := RK(C)				*/
 OP_SETFIELD,/*	A B C	R[A][K[B]:string] := RK(C)			*/
+OP_SETFIELD2,/*A B C	R[A][K[B]:string] := RK(C); then the next OP_SETFIELD */
 
 OP_NEWTABLE,/*	A B C k	R[A] := {}					*/
+OP_NEWTABLEK,/*	A Bx	R[A] := copy of K[Bx]				*/
 
 OP_SELF,/*	A B C	R[A+1] := R[B]; R[A] := R[B][RK(C):string]	*/
 
@@ -254,6 +262,14 @@ OP_BXOR,/*	A B C	R[A] := R[B] ~ R[C]				*/
 OP_SHL,/*	A B C	R[A] := R[B] << R[C]				*/
 OP_SHR,/*	A B C	R[A] := R[B] >> R[C]				*/
 
+OP_ADDII,/*	A B C	R[A] := R[B] + R[C] (integers)			*/
+OP_SUBII,/*	A B C	R[A] := R[B] - R[C] (integers)			*/
+OP_MULII,/*	A B C	R[A] := R[B] * R[C] (integers)			*/
+OP_ADDFF,/*	A B C	R[A] := R[B] + R[C] (floats)			*/
+OP_SUBFF,/*	A B C	R[A] := R[B] - R[C] (floats)			*/
+OP_MULFF,/*	A B C	R[A] := R[B] * R[C] (floats)			*/
+OP_DIVFF,/*	A B C	R[A] := R[B] / R[C] (floats)			*/
+
 OP_MMBIN,/*	A B C	call C metamethod over R[A] and R[B]		*/
 OP_MMBINI,/*	A sB C k	call C metamethod over R[A] and sB	*/
 OP_MMBINK,/*	A B C k		call C metamethod over R[A] and K[B]	*/
@@ -268,6 +284,7 @@ OP_CONCAT,/*	A B	R[A] := R[A].. ... ..R[A + B - 1]		*/
 OP_CLOSE,/*	A	close all upvalues >= R[A]			*/
 OP_TBC,/*	A	mark variable A "to be closed"			*/
 OP_JMP,/*	sJ	pc += sJ					*/
+OP_SWITCH,/*	A Bx	if K[Bx][R[A]] ~= nil then pc += K[Bx][R[A]]	*/
 OP_EQ,/*	A B k	if ((R[A] == R[B]) ~= k) then pc++		*/
 OP_LT,/*	A B k	if ((R[A] <  R[B]) ~= k) then pc++		*/
 OP_LE,/*	A B k	if ((R[A] <= R[B]) ~= k) then pc++		*/
@@ -279,10 +296,16 @@ OP_LEI,/*	A sB k	if ((R[A] <= sB) ~= k) then pc++		*/
 OP_GTI,/*	A sB k	if ((R[A] > sB) ~= k) then pc++			*/
 OP_GEI,/*	A sB k	if ((R[A] >= sB) ~= k) then pc++		*/
 
+OP_LTII,/*	A B k	if ((R[A] <  R[B]) ~= k) then pc++ (integers)	*/
+OP_LEII,/*	A B k	if ((R[A] <= R[B]) ~= k) then pc++ (integers)	*/
+OP_LTFF,/*	A B k	if ((R[A] <  R[B]) ~= k) then pc++ (floats)	*/
+OP_LEFF,/*	A B k	if ((R[A] <= R[B]) ~= k) then pc++ (floats)	*/
+
 OP_TEST,/*	A k	if (not R[A] == k) then pc++			*/
 OP_TESTSET,/*	A B k	if (not R[B] == k) then pc++ else R[A] := R[B]	*/
 
 OP_CALL,/*	A B C	R[A], ... ,R[A+C-2] := R[A](R[A+1], ... ,R[A+B-1]) */
+OP_CALLL,/*	A B C	OP_CALL specialized for Lua functions (see note) */
 OP_TAILCALL,/*	A B C k	return R[A](R[A+1], ... ,R[A+B-1])		*/
 
 OP_RETURN,/*	A B C k	return R[A], ... ,R[A+B-2]	(see note)	*/
@@ -292,6 +315,14 @@ OP_RETURN1,/*	A	return R[A]					*/
 OP_FORLOOP,/*	A Bx	update counters; if loop continues then pc-=Bx; */
 OP_FORPREP,/*	A Bx	<check values and prepare counters>;
                         if not to run then pc+=Bx+1;			*/
+OP_FORPREPH,/*	A Bx	OP_FORPREP, but if to run then pc+=Bx+2		*/
+
+OP_HOISTUP,/*	A B C	H[A] := UpValue[B][K[C]:string] (raw, see note) */
+OP_HOISTFIELD,/*A B C	H[A] := H[B][K[C]:string] (raw, see note)	*/
+OP_HOISTDONE,/*	A Bx	H[A], H[A+1] := current hoisting epoch, closure;
+                        pc-=Bx						*/
+OP_GETHOIST,/*	A B C	if H[A], H[A+1] are current and H[B] ~= nil then
+                        { R[A'] := H[B]; pc+=C } (see note)		*/
 
 OP_TFORPREP,/*	A Bx	create upvalue for R[A + 3]; pc+=Bx		*/
 OP_TFORCALL,/*	A C	R[A+4], ... ,R[A+3+C] := R[A](R[A+1], R[A+2]);	*/
@@ -303,6 +334,8 @@ OP_CLOSURE,/*	A Bx	R[A] := closure(KPROTO[Bx])			*/
 
 OP_VARARG,/*	A C	R[A], R[A+1], ..., R[A+C-2] = vararg		*/
 
+OP_SELECT,/*	A	if R[A] is 'select' then R[A], ... = select(R[A+1], ...); pc+=2 */
+
 OP_VARARGPREP,/*A	(adjust vararg parameters)			*/
 
 OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
@@ -319,9 +352,43 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
   'top' is set to last_result+1, so next open instruction (OP_CALL,
   OP_RETURN*, OP_SETLIST) may use 'top'.
 
+  (*) OP_CALL sites that call a non-vararg Lua function with exactly its
+  number of parameters become OP_CALLL, which sets up such calls without
+  going through 'ecierthonD_precall'. When an OP_CALLL finds any other
+  callee, it turns back into OP_CALL with k = 1, which marks the site
+  as not worth specializing again. Code shared with other states or
+  dumped is never rewritten and always has the original OP_CALL.
+
+  (*) A numeric loop with hoisted loads starts with OP_FORPREPH, which
+  enters the loop through a block placed after its OP_FORLOOP (and a
+  jump over it). That block computes each hoisted value into a slot
+  H[x] of the prototype (not a register) with OP_HOISTUP/OP_HOISTFIELD,
+  which read raw fields, leave nil for anything missing, and mark the
+  tables they read as watched; then OP_HOISTDONE stamps the loop with
+  the current hoisting epoch and the running closure and jumps to the
+  loop body. Any change to a watched table moves the epoch. Each use of
+  a hoisted value is an OP_GETHOIST followed by the C ordinary
+  instructions that compute it; while the stamp is current (and from
+  the same closure), OP_GETHOIST copies the hoisted value to the
+  register A' of the last of those instructions and skips them.
+
+  (*) OP_MOVE2, OP_GETFIELD2 and OP_SETFIELD2 are superinstructions
+  for the most frequent pairs of opcodes: each one is the first of two
+  consecutive instructions with the same base opcode, and the second
+  one stays in the code as it is. After doing its own work, a
+  superinstruction runs the fast path of the second one too and skips
+  it, saving a dispatch; when that fast path does not apply (or hooks
+  are on), the second one just runs as usual.
+
   (*) In OP_VARARG, if (C == 0) then use actual number of varargs and
   set top (like in OP_CALL with C == 0).
 
+  (*) OP_SELECT is always followed by the OP_VARARG and the OP_CALL
+  (or OP_TAILCALL) of a call 'select(x, ...)'. When R[A] is the
+  standard 'select', it produces the results of that call directly
+  from the vararg area and skips both instructions; otherwise it does
+  nothing and the call runs as usual.
+
   (*) In OP_RETURN, if (B == 0) then return up to 'top'.
 
   (*) In OP_LOADKX and OP_NEWTABLE, the next instruction is always
@@ -382,6 +449,11 @@ ecierthonI_DDEC(const lu_byte ecierthonP_opmodes[NUM_OPCODES];)
 /* "in top" (uses top from previous instruction) */
 #define isIT(i)		(testITMode(GET_OPCODE(i)) && GETARG_B(i) == 0)
 
+/* undo the run-time specialization of a call site (see OP_CALLL) */
+#define unspecialize(i)  \
+	{ if (GET_OPCODE(i) == OP_CALL || GET_OPCODE(i) == OP_CALLL) \
+	    { SET_OPCODE(i, OP_CALL); SETARG_k(i, 0); } }
+
 #define opmode(mm,ot,it,t,a,m)  \
     (((mm) << 7) | ((ot) << 6) | ((it) << 5) | ((t) << 4) | ((a) << 3) | (m))
 
@@ -14,6 +14,8 @@
 
 static const char *const opnames[] = {
   "MOVE",
+  "MOVE2",
+  "CHECKTYPE",
   "LOADI",
   "LOADF",
   "LOADK",
@@ -24,15 +26,21 @@ static const char *const opnames[] = {
   "LOADNIL",
   "GETUPVAL",
   "SETUPVAL",
+  "GETFLAT",
   "GETTABUP",
+  "GETTABFLAT",
   "GETTABLE",
   "GETI",
   "GETFIELD",
+  "GETFIELD2",
   "SETTABUP",
+  "SETTABFLAT",
   "SETTABLE",
   "SETI",
   "SETFIELD",
+  "SETFIELD2",
   "NEWTABLE",
+  "NEWTABLEK",
   "SELF",
   "ADDI",
   "ADDK",
@@ -59,6 +67,13 @@ static const char *const opnames[] = {
   "BXOR",
   "SHL",
   "SHR",
+  "ADDII",
+  "SUBII",
+  "MULII",
+  "ADDFF",
+  "SUBFF",
+  "MULFF",
+  "DIVFF",
   "MMBIN",
   "MMBINI",
   "MMBINK",
@@ -70,6 +85,7 @@ static const char *const opnames[] = {
   "CLOSE",
   "TBC",
   "JMP",
+  "SWITCH",
   "EQ",
   "LT",
   "LE",
@@ -79,21 +95,32 @@ static const char *const opnames[] = {
   "LEI",
   "GTI",
   "GEI",
+  "LTII",
+  "LEII",
+  "LTFF",
+  "LEFF",
   "TEST",
   "TESTSET",
   "CALL",
+  "CALLL",
   "TAILCALL",
   "RETURN",
   "RETURN0",
   "RETURN1",
   "FORLOOP",
   "FORPREP",
+  "FORPREPH",
+  "HOISTUP",
+  "HOISTFIELD",
+  "HOISTDONE",
+  "GETHOIST",
   "TFORPREP",
   "TFORCALL",
   "TFORLOOP",
   "SETLIST",
   "CLOSURE",
   "VARARG",
+  "SELECT",
   "VARARGPREP",
   "EXTRAARG",
   NULL
@@ -153,6 +153,7 @@ static void init_exp (expdesc *e, expkind k, int i) {
   e->f = e->t = NO_JUMP;
   e->k = k;
   e->u.info = i;
+  e->nt = NTANY;
 }
 
 
@@ -160,6 +161,7 @@ static void codestring (expdesc *e, TString *s) {
   e->f = e->t = NO_JUMP;
   e->k = VKSTR;
   e->u.strval = s;
+  e->nt = NTANY;
 }
 
 
@@ -201,6 +203,8 @@ static int new_localvar (LexState *ls, TString *name) {
                   dyd->actvar.size, Vardesc, USHRT_MAX, "local variables");
   var = &dyd->actvar.arr[dyd->actvar.n++];
   var->vd.kind = VDKREG;  /* default */
+  var->vd.captured = var->vd.assigned = 0;
+  var->vd.nt = NTANY;
   var->vd.name = name;
   return dyd->actvar.n - 1 - fs->firstlocal;
 }
@@ -268,6 +272,40 @@ static void init_var (FuncState *fs, expdesc *e, int vidx) {
   e->k = VLOCAL;
   e->u.var.vidx = vidx;
   e->u.var.sidx = getlocalvardesc(fs, vidx)->vd.sidx;
+  e->nt = getlocalvardesc(fs, vidx)->vd.nt;
+}
+
+
+/*
+** Mark the variable described by 'e' as assigned. For an upvalue,
+** follow the chain of enclosing functions to the local variable it
+** refers to. (That variable is still active, as 'e' is visible.)
+*/
+static void markassigned (FuncState *fs, expdesc *e) {
+  int idx;
+  if (e->k == VLOCAL) {
+    getlocalvardesc(fs, e->u.var.vidx)->vd.assigned = 1;
+    return;
+  }
+  else if (e->k != VUPVAL)
+    return;  /* not a variable */
+  idx = e->u.info;
+  for (; fs->prev != NULL; fs = fs->prev) {
+    Upvaldesc *up = &fs->f->upvalues[idx];
+    if (up->instack) {  /* refers to a local of the enclosing function? */
+      FuncState *prev = fs->prev;
+      int i;
+      for (i = 0; i < prev->nactvar; i++) {
+        Vardesc *vd = getlocalvardesc(prev, i);
+        if (vd->vd.kind != RDKCTC && vd->vd.sidx == up->idx) {
+          vd->vd.assigned = 1;
+          return;
+        }
+      }
+      return;
+    }
+    idx = up->idx;
+  }
 }
 
 
@@ -277,6 +315,7 @@ static void init_var (FuncState *fs, expdesc *e, int vidx) {
 static void check_readonly (LexState *ls, expdesc *e) {
   FuncState *fs = ls->fs;
   TString *varname = NULL;  /* to be set if variable is const */
+  markassigned(fs, e);
   switch (e->k) {
     case VCONST: {
       varname = ls->dyd->actvar.arr[e->u.info].vd.name;
@@ -317,6 +356,7 @@ static void adjustlocalvars (LexState *ls, int nvars) {
     Vardesc *var = getlocalvardesc(fs, vidx);
     var->vd.sidx = stklevel++;
     var->vd.pidx = registerlocalvar(ls, fs, var->vd.name);
+    var->vd.firstp = fs->np;
   }
 }
 
@@ -355,8 +395,11 @@ static Upvaldesc *allocupvalue (FuncState *fs) {
   checklimit(fs, fs->nups + 1, MAXUPVAL, "upvalues");
   ecierthonM_growvector(fs->ls->L, f->upvalues, fs->nups, f->sizeupvalues,
                   Upvaldesc, MAXUPVAL, "upvalues");
-  while (oldsize < f->sizeupvalues)
-    f->upvalues[oldsize++].name = NULL;
+  while (oldsize < f->sizeupvalues) {
+    f->upvalues[oldsize].name = NULL;
+    f->upvalues[oldsize].nt = NTANY;
+    f->upvalues[oldsize++].flat = 0;
+  }
   return &f->upvalues[fs->nups++];
 }
 
@@ -368,14 +411,17 @@ static int newupvalue (FuncState *fs, TString *name, expdesc *v) {
     up->instack = 1;
     up->idx = v->u.var.sidx;
     up->kind = getlocalvardesc(prev, v->u.var.vidx)->vd.kind;
+    up->nt = getlocalvardesc(prev, v->u.var.vidx)->vd.nt;
     ecierthon_assert(eqstr(name, getlocalvardesc(prev, v->u.var.vidx)->vd.name));
   }
   else {
     up->instack = 0;
     up->idx = cast_byte(v->u.info);
     up->kind = prev->f->upvalues[v->u.info].kind;
+    up->nt = prev->f->upvalues[v->u.info].nt;
     ecierthon_assert(eqstr(name, prev->f->upvalues[v->u.info].name));
   }
+  up->flat = 0;
   up->name = name;
   ecierthonC_objbarrier(fs->ls->L, fs->f, name);
   return fs->nups - 1;
@@ -427,8 +473,10 @@ static void singlevaraux (FuncState *fs, TString *n, expdesc *var, int base) {
   else {
     int v = searchvar(fs, n, var);  /* look up locals at current level */
     if (v >= 0) {  /* found? */
-      if (v == VLOCAL && !base)
+      if (v == VLOCAL && !base) {
         markupval(fs, var->u.var.vidx);  /* local will be used as an upval */
+        getlocalvardesc(fs, var->u.var.vidx)->vd.captured = 1;
+      }
     }
     else {  /* not found as local at current level; try upvalues */
       int idx = searchupvalue(fs, n);  /* try existing upvalues */
@@ -440,6 +488,7 @@ static void singlevaraux (FuncState *fs, TString *n, expdesc *var, int base) {
           return;  /* don't need to do anything at this level */
       }
       init_exp(var, VUPVAL, idx);  /* new or old upvalue */
+      var->nt = fs->f->upvalues[idx].nt;
     }
   }
 }
@@ -657,11 +706,86 @@ static l_noret undefgoto (LexState *ls, Labeldesc *gt) {
 }
 
 
+/*
+** {======================================================
+** Flat upvalues: a captured variable that is never assigned after
+** its creation has the same value during its whole life, so closures
+** can keep a copy of that value instead of sharing an UpVal. This is
+** decided when the variable goes out of scope, by which time all
+** functions that capture it are complete; their code is then patched
+** to use the flat versions of the upvalue instructions.
+** =======================================================
+*/
+
+/*
+** Make upvalue 'idx' of prototype 'f' flat, patching the instructions
+** that access it and the upvalues of inner functions that refer to it.
+*/
+static void flattenupval (Proto *f, int idx) {
+  int pc, i, j;
+  f->upvalues[idx].flat = 1;
+  for (pc = 0; pc < f->sizecode; pc++) {
+    Instruction *pi = &f->code[pc];
+    switch (GET_OPCODE(*pi)) {
+      case OP_GETUPVAL:
+        if (GETARG_B(*pi) == idx) SET_OPCODE(*pi, OP_GETFLAT);
+        break;
+      case OP_GETTABUP:
+        if (GETARG_B(*pi) == idx) SET_OPCODE(*pi, OP_GETTABFLAT);
+        break;
+      case OP_SETTABUP:
+        if (GETARG_A(*pi) == idx) SET_OPCODE(*pi, OP_SETTABFLAT);
+        break;
+      default: break;
+    }
+  }
+  for (i = 0; i < f->sizep; i++) {
+    Proto *c = f->p[i];
+    for (j = 0; j < c->sizeupvalues; j++) {
+      if (!c->upvalues[j].instack && c->upvalues[j].idx == idx)
+        flattenupval(c, j);
+    }
+  }
+}
+
+
+/*
+** Flatten the captured variables of block 'bl' that are never
+** assigned. Returns true if the block still needs to close
+** upvalues (some captured variable is assigned or some variable
+** is to be closed).
+*/
+static int flattenvars (FuncState *fs, BlockCnt *bl) {
+  int needclose = 0;
+  int vidx;
+  for (vidx = bl->nactvar; vidx < fs->nactvar; vidx++) {
+    Vardesc *vd = getlocalvardesc(fs, vidx);
+    if (vd->vd.kind == RDKTOCLOSE || (vd->vd.captured && vd->vd.assigned))
+      needclose = 1;
+    else if (vd->vd.captured) {
+      int i, j;
+      for (i = vd->vd.firstp; i < fs->np; i++) {
+        Proto *c = fs->f->p[i];
+        for (j = 0; j < c->sizeupvalues; j++) {
+          if (c->upvalues[j].instack && c->upvalues[j].idx == vd->vd.sidx)
+            flattenupval(c, j);
+        }
+      }
+    }
+  }
+  return needclose;
+}
+
+/* }====================================================== */
+
+
 static void leaveblock (FuncState *fs) {
   BlockCnt *bl = fs->bl;
   LexState *ls = fs->ls;
   int hasclose = 0;
   int stklevel = stacklevel(fs, bl->nactvar);  /* level outside the block */
+  if (bl->upval && !flattenvars(fs, bl))
+    bl->upval = 0;  /* no open upvalues left in the block */
   if (bl->isloop)  /* fix pending breaks? */
     hasclose = createlabel(ls, ecierthonS_newliteral(ls->L, "break"), 0, 0);
   if (!hasclose && bl->previous && bl->upval)
@@ -726,11 +850,13 @@ static void open_func (LexState *ls, FuncState *fs, BlockCnt *bl) {
   fs->freereg = 0;
   fs->nk = 0;
   fs->nabslineinfo = 0;
+  fs->nhoist = 0;
   fs->np = 0;
   fs->nups = 0;
   fs->ndebugvars = 0;
   fs->nactvar = 0;
   fs->needclose = 0;
+  fs->lh = NULL;
   fs->firstlocal = ls->dyd->actvar.n;
   fs->firstlabel = ls->dyd->label.n;
   fs->bl = NULL;
@@ -829,14 +955,83 @@ typedef struct ConsControl {
   int nh;  /* total number of 'record' elements */
   int na;  /* number of array elements already stored */
   int tostore;  /* number of array elements pending to be stored */
+  int allk;  /* true while all fields are constants */
+  Table *tmpl;  /* template with those fields (created on demand) */
+  TValue pending[LFIELDS_PER_FLUSH];  /* values of pending array elements */
 } ConsControl;
 
 
+/*
+** {======================================================
+** Table templates: a constructor whose keys and values are all
+** constants is compiled to an OP_NEWTABLEK, which copies a table
+** built here (the template) instead of storing each field. Fields go
+** into the template in the order the regular code would store them
+** (array elements only when they are flushed), so that repeated keys
+** end with the same values. Values can be templates themselves.
+** =======================================================
+*/
+
+/*
+** Check whether the value 'e' just parsed can go into a template: a
+** non-nil constant or a constructor that became a template.
+*/
+static int templatevalue (FuncState *fs, expdesc *e, TValue *v) {
+  if (e->k == VNONRELOC && fs->pc > 0) {
+    Instruction i = fs->f->code[fs->pc - 1];
+    if (GET_OPCODE(i) == OP_NEWTABLEK && GETARG_A(i) == e->u.info) {
+      sethvalue(fs->ls->L, v, hvalue(&fs->f->k[GETARG_Bx(i)]));
+      return 1;
+    }
+  }
+  return (ecierthonK_exp2const(fs, e, v) && !ttisnil(v));
+}
+
+
+/*
+** Set 'key'-'val' in the template of 'cc', creating it if needed.
+** (Templates are anchored in the scanner table while the parser runs.)
+*/
+static void templateset (LexState *ls, ConsControl *cc, const TValue *key,
+                         const TValue *val) {
+  ecierthon_State *L = ls->L;
+  TValue *slot;
+  if (cc->tmpl == NULL) {
+    cc->tmpl = ecierthonH_new(L);
+    sethvalue2s(L, L->top, cc->tmpl);  /* anchor it */
+    ecierthonD_inctop(L);
+    slot = ecierthonH_set(L, ls->h, s2v(L->top - 1));
+    setbtvalue(slot);  /* t[template] = true */
+    L->top--;
+  }
+  slot = ecierthonH_set(L, cc->tmpl, key);
+  setobj2t(L, slot, val);
+  ecierthonC_barrierback(L, obj2gco(cc->tmpl), val);
+}
+
+
+/*
+** Put the pending array elements in the template, at the positions
+** where an OP_SETLIST would store them now.
+*/
+static void templateflush (LexState *ls, ConsControl *cc) {
+  int i;
+  for (i = 0; i < cc->tostore && cc->allk; i++) {
+    TValue key;
+    setivalue(&key, cast(ecierthon_Integer, cc->na) + i + 1);
+    templateset(ls, cc, &key, &cc->pending[i]);
+  }
+}
+
+/* }====================================================== */
+
+
 static void recfield (LexState *ls, ConsControl *cc) {
   /* recfield -> (NAME | '['exp']') = exp */
   FuncState *fs = ls->fs;
   int reg = ls->fs->freereg;
   expdesc tab, key, val;
+  TValue k, v;
   if (ls->t.token == TK_NAME) {
     checklimit(fs, cc->nh, MAX_INT, "items in a constructor");
     codename(ls, &key);
@@ -845,9 +1040,17 @@ static void recfield (LexState *ls, ConsControl *cc) {
     yindex(ls, &key);
   cc->nh++;
   checknext(ls, '=');
+  if (cc->allk && !(ecierthonK_exp2const(fs, &key, &k) && !ttisnil(&k)))
+    cc->allk = 0;  /* key is not a constant */
   tab = *cc->t;
   ecierthonK_indexed(fs, &tab, &key);
   expr(ls, &val);
+  if (cc->allk) {
+    if (templatevalue(fs, &val, &v))
+      templateset(ls, cc, &k, &v);
+    else
+      cc->allk = 0;
+  }
   ecierthonK_storevar(fs, &tab, &val);
   fs->freereg = reg;  /* free registers */
 }
@@ -855,9 +1058,12 @@ static void recfield (LexState *ls, ConsControl *cc) {
 
 static void closelistfield (FuncState *fs, ConsControl *cc) {
   if (cc->v.k == VVOID) return;  /* there is no list item */
+  if (cc->allk && !templatevalue(fs, &cc->v, &cc->pending[cc->tostore - 1]))
+    cc->allk = 0;
   ecierthonK_exp2nextreg(fs, &cc->v);
   cc->v.k = VVOID;
   if (cc->tostore == LFIELDS_PER_FLUSH) {
+    templateflush(fs->ls, cc);
     ecierthonK_setlist(fs, cc->t->u.info, cc->na, cc->tostore);  /* flush */
     cc->na += cc->tostore;
     cc->tostore = 0;  /* no more items pending */
@@ -868,13 +1074,19 @@ static void closelistfield (FuncState *fs, ConsControl *cc) {
 static void lastlistfield (FuncState *fs, ConsControl *cc) {
   if (cc->tostore == 0) return;
   if (hasmultret(cc->v.k)) {
+    cc->allk = 0;
     ecierthonK_setmultret(fs, &cc->v);
     ecierthonK_setlist(fs, cc->t->u.info, cc->na, ecierthon_MULTRET);
     cc->na--;  /* do not count last expression (unknown number of elements) */
   }
   else {
-    if (cc->v.k != VVOID)
+    if (cc->v.k != VVOID) {
+      if (cc->allk &&
+          !templatevalue(fs, &cc->v, &cc->pending[cc->tostore - 1]))
+        cc->allk = 0;
       ecierthonK_exp2nextreg(fs, &cc->v);
+    }
+    templateflush(fs->ls, cc);
     ecierthonK_setlist(fs, cc->t->u.info, cc->na, cc->tostore);
   }
   cc->na += cc->tostore;
@@ -915,10 +1127,13 @@ static void constructor (LexState *ls, expdesc *t) {
      sep -> ',' | ';' */
   FuncState *fs = ls->fs;
   int line = ls->linenumber;
+  int nk = fs->nk;  /* constants created from here are only for the fields */
   int pc = ecierthonK_codeABC(fs, OP_NEWTABLE, 0, 0, 0);
   ConsControl cc;
   ecierthonK_code(fs, 0);  /* space for extra arg. */
   cc.na = cc.nh = cc.tostore = 0;
+  cc.allk = 1;
+  cc.tmpl = NULL;
   cc.t = t;
   init_exp(t, VNONRELOC, fs->freereg);  /* table will be at stack top */
   ecierthonK_reserveregs(fs, 1);
@@ -932,6 +1147,12 @@ static void constructor (LexState *ls, expdesc *t) {
   } while (testnext(ls, ',') || testnext(ls, ';'));
   check_match(ls, '}', '{', line);
   lastlistfield(fs, &cc);
+  if (cc.allk && cc.tmpl != NULL) {  /* only constant fields? */
+    /* give the template the layout the regular code would create */
+    ecierthonH_resize(ls->L, cc.tmpl, cc.na, cc.nh);
+    if (ecierthonK_template(fs, pc, t->u.info, nk, cc.tmpl, line))
+      return;
+  }
   ecierthonK_settablesize(fs, pc, t->u.info, cc.na, cc.nh);
 }
 
@@ -1010,7 +1231,37 @@ static int explist (LexState *ls, expdesc *v) {
 }
 
 
-static void funcargs (LexState *ls, expdesc *f, int line) {
+/*
+** Check whether 'v' is named 'select' (a variable or a field), so that
+** its calls over '...' may be run by OP_SELECT.
+*/
+static int isselect (FuncState *fs, expdesc *v) {
+  TString *name;
+  switch (v->k) {
+    case VLOCAL: name = getlocalvardesc(fs, v->u.var.vidx)->vd.name; break;
+    case VUPVAL: name = fs->f->upvalues[v->u.info].name; break;
+    case VINDEXUP: case VINDEXSTR: name = tsvalue(&fs->f->k[v->u.ind.idx]); break;
+    default: return 0;
+  }
+  return (name != NULL && strcmp(getstr(name), "select") == 0);
+}
+
+
+/*
+** Call 'select(x, ...)': put an OP_SELECT in front of its OP_VARARG (see
+** lopcodes.h). OP_SELECT takes the place of the OP_VARARG, so that any
+** jump to the end of 'x' reaches it.
+*/
+static void selectvararg (FuncState *fs, expdesc *args, int base) {
+  Instruction *pi = &getinstruction(fs, args);
+  Instruction vararg = *pi;
+  ecierthon_assert(args->u.info == fs->pc - 1);
+  *pi = CREATE_ABCk(OP_SELECT, base, 0, 0, 0);
+  args->u.info = ecierthonK_code(fs, vararg);
+}
+
+
+static void funcargs (LexState *ls, expdesc *f, int line, int select) {
   FuncState *fs = ls->fs;
   expdesc args;
   int base, nparams;
@@ -1021,8 +1272,12 @@ static void funcargs (LexState *ls, expdesc *f, int line) {
         args.k = VVOID;
       else {
         explist(ls, &args);
-        if (hasmultret(args.k))
+        if (hasmultret(args.k)) {
           ecierthonK_setmultret(fs, &args);
+          if (select && args.k == VVARARG &&  /* 'select(x, ...)'? */
+              GETARG_A(getinstruction(fs, &args)) == f->u.info + 2)
+            selectvararg(fs, &args, f->u.info);
+        }
       }
       check_match(ls, ')', '(', line);
       break;
@@ -1111,12 +1366,13 @@ static void suffixedexp (LexState *ls, expdesc *v) {
         ecierthonX_next(ls);
         codename(ls, &key);
         ecierthonK_self(fs, v, &key);
-        funcargs(ls, v, line);
+        funcargs(ls, v, line, 0);
         break;
       }
       case '(': case TK_STRING: case '{': {  /* funcargs */
+        int select = isselect(fs, v);
         ecierthonK_exp2nextreg(fs, v);
-        funcargs(ls, v, line);
+        funcargs(ls, v, line, select);
         break;
       }
       default: return;
@@ -1526,6 +1782,26 @@ static void fixforjump (FuncState *fs, int pc, int dest, int back) {
 }
 
 
+/*
+** Code the loads hoisted out of the loop whose OP_FORPREP (now OP_FORPREPH)
+** is at 'prep', after its OP_FORLOOP: the loop enters through them, and
+** their OP_HOISTDONE goes to the loop body. The loop exit jumps over them.
+*/
+static void closehoist (FuncState *fs, LoopHoist *lh, int prep, int line) {
+  int exit = ecierthonK_jump(fs);
+  int i, done;
+  SET_OPCODE(fs->f->code[prep], OP_FORPREPH);  /* enter through them */
+  for (i = 0; i < lh->n; i++) {
+    ecierthonK_code(fs, lh->load[i]);
+    ecierthonK_fixline(fs, line);
+  }
+  done = ecierthonK_codeABx(fs, OP_HOISTDONE, lh->stamp, 0);
+  ecierthonK_fixline(fs, line);
+  fixforjump(fs, done, prep + 1, 1);
+  ecierthonK_patchtohere(fs, exit);
+}
+
+
 /*
 ** Generate code for a 'for' loop.
 */
@@ -1535,13 +1811,22 @@ static void forbody (LexState *ls, int base, int line, int nvars, int isgen) {
   static const OpCode forloop[2] = {OP_FORLOOP, OP_TFORLOOP};
   BlockCnt bl;
   FuncState *fs = ls->fs;
+  LoopHoist lh;
+  LoopHoist *prevlh = fs->lh;
   int prep, endfor;
   checknext(ls, TK_DO);
   prep = ecierthonK_codeABx(fs, forprep[isgen], base, 0);
   enterblock(fs, &bl, 0);  /* scope for declared variables */
   adjustlocalvars(ls, nvars);
   ecierthonK_reserveregs(fs, nvars);
+  if (!isgen) {  /* numeric loop? (may hoist loads) */
+    lh.stamp = -1;
+    lh.n = 0;
+    lh.lastuse = -1;
+    fs->lh = &lh;
+  }
   block(ls);
+  fs->lh = prevlh;
   leaveblock(fs);  /* end of scope for declared variables */
   fixforjump(fs, prep, ecierthonK_getlabel(fs), 0);
   if (isgen) {  /* generic for? */
@@ -1551,6 +1836,8 @@ static void forbody (LexState *ls, int base, int line, int nvars, int isgen) {
   endfor = ecierthonK_codeABx(fs, forloop[isgen], base, 0);
   fixforjump(fs, endfor, prep + 1, 1);
   ecierthonK_fixline(fs, line);
+  if (!isgen && lh.n > 0)
+    closehoist(fs, &lh, prep, line);
 }
 
 
@@ -1623,12 +1910,18 @@ static void forstat (LexState *ls, int line) {
 }
 
 
-static void test_then_block (LexState *ls, int *escapelist) {
+/*
+** Parses one clause of an 'if' statement. Returns the position of its
+** test if it is only a comparison of a register with a constant, in
+** the form accepted by 'ecierthonK_casereg'; otherwise returns -1.
+*/
+static int test_then_block (LexState *ls, int *escapelist) {
   /* test_then_block -> [IF | ELSEIF] cond THEN block */
   BlockCnt bl;
   FuncState *fs = ls->fs;
   expdesc v;
   int jf;  /* instruction to skip 'then' code (if condition is false) */
+  int test = fs->pc;  /* position of the test */
   ecierthonX_next(ls);  /* skip IF or ELSEIF */
   expr(ls, &v);  /* read condition */
   checknext(ls, TK_THEN);
@@ -1641,15 +1934,19 @@ static void test_then_block (LexState *ls, int *escapelist) {
     while (testnext(ls, ';')) {}  /* skip semicolons */
     if (block_follow(ls, 0)) {  /* jump is the entire block? */
       leaveblock(fs);
-      return;  /* and that is it */
+      return -1;  /* and that is it */
     }
     else  /* must skip over 'then' part if condition is false */
       jf = ecierthonK_jump(fs);
+    test = -1;
   }
   else {  /* regular case (not a break) */
     ecierthonK_goiftrue(ls->fs, &v);  /* skip over block if condition is false */
     enterblock(fs, &bl, 0);
     jf = v.f;
+    if (!(fs->pc == test + 2 && jf == test + 1 &&
+          ecierthonK_casereg(fs, test) >= 0))
+      test = -1;  /* not a simple comparison */
   }
   statlist(ls);  /* 'then' part */
   leaveblock(fs);
@@ -1657,20 +1954,38 @@ static void test_then_block (LexState *ls, int *escapelist) {
       ls->t.token == TK_ELSEIF)  /* followed by 'else'/'elseif'? */
     ecierthonK_concat(fs, escapelist, ecierthonK_jump(fs));  /* must jump over it */
   ecierthonK_patchtohere(fs, jf);
+  return test;
 }
 
 
+/*
+** Minimum number of leading clauses comparing the same register with
+** constants for an 'if' statement to dispatch through an OP_SWITCH.
+*/
+#define MINSWITCH	4
+
+
 static void ifstat (LexState *ls, int line) {
   /* ifstat -> IF cond THEN block {ELSEIF cond THEN block} [ELSE block] END */
   FuncState *fs = ls->fs;
   int escapelist = NO_JUMP;  /* exit list for finished parts */
-  test_then_block(ls, &escapelist);  /* IF cond THEN block */
-  while (ls->t.token == TK_ELSEIF)
-    test_then_block(ls, &escapelist);  /* ELSEIF cond THEN block */
+  int first = test_then_block(ls, &escapelist);  /* IF cond THEN block */
+  int ncases = (first >= 0);  /* length of the chain of simple tests */
+  int chain = (first >= 0);  /* is the chain still growing? */
+  while (ls->t.token == TK_ELSEIF) {
+    int test = test_then_block(ls, &escapelist);  /* ELSEIF cond THEN block */
+    if (chain && test >= 0 &&
+        ecierthonK_casereg(fs, test) == ecierthonK_casereg(fs, first))
+      ncases++;
+    else
+      chain = 0;
+  }
   if (testnext(ls, TK_ELSE))
     block(ls);  /* 'else' part */
   check_match(ls, TK_END, TK_IF, line);
   ecierthonK_patchtohere(fs, escapelist);  /* patch escape list to 'if' end */
+  if (ncases >= MINSWITCH)
+    ecierthonK_switch(fs, first, ncases);
 }
 
 
@@ -1680,13 +1995,15 @@ static void localfunc (LexState *ls) {
   int fvar = fs->nactvar;  /* function's variable index */
   new_localvar(ls, str_checkname(ls));  /* new local variable */
   adjustlocalvars(ls, 1);  /* enter its scope */
+  /* the function may capture its variable before it is initialized */
+  getlocalvardesc(fs, fvar)->vd.assigned = 1;
   body(ls, &b, 0, ls->linenumber);  /* function created in next register */
   /* debug information will only see the variable after this point! */
   localdebuginfo(fs, fvar)->startpc = fs->pc;
 }
 
 
-static int getlocalattribute (LexState *ls) {
+static int getlocalattribute (LexState *ls, lu_byte *nt) {
   /* ATTRIB -> ['<' Name '>'] */
   if (testnext(ls, '<')) {
     const char *attr = getstr(str_checkname(ls));
@@ -1695,6 +2012,10 @@ static int getlocalattribute (LexState *ls) {
       return RDKCONST;  /* read-only variable */
     else if (strcmp(attr, "close") == 0)
       return RDKTOCLOSE;  /* to-be-closed variable */
+    else if (strcmp(attr, "int") == 0)
+      *nt = NTINT;  /* regular variable, always an integer */
+    else if (strcmp(attr, "float") == 0)
+      *nt = NTFLT;  /* regular variable, always a float */
     else
       ecierthonK_semerror(ls,
         ecierthonO_pushfstring(ls->L, "unknown attribute '%s'", attr));
@@ -1713,6 +2034,29 @@ static void checktoclose (LexState *ls, int level) {
 }
 
 
+/*
+** Static type of the 'n'-th (1-based) of the 'nvars' new variables of
+** a local declaration, whose last one is 'vidx'.
+*/
+static int localtype (FuncState *fs, int vidx, int nvars, int n) {
+  if (n > nvars)
+    return NTANY;  /* extra value */
+  return getlocalvardesc(fs, vidx - nvars + n)->vd.nt;
+}
+
+
+/*
+** Close the 'n'-th expression of a local declaration, converting or
+** checking its value if the variable it initializes is typed.
+*/
+static void localexp (FuncState *fs, expdesc *e, int nt) {
+  if (nt == NTANY)
+    ecierthonK_exp2nextreg(fs, e);
+  else
+    ecierthonK_exp2typed(fs, e, nt);
+}
+
+
 static void localstat (LexState *ls) {
   /* stat -> LOCAL NAME ATTRIB { ',' NAME ATTRIB } ['=' explist] */
   FuncState *fs = ls->fs;
@@ -1720,12 +2064,14 @@ static void localstat (LexState *ls) {
   Vardesc *var;  /* last variable */
   int vidx, kind;  /* index and kind of last variable */
   int nvars = 0;
-  int nexps;
+  int nexps = 0;
+  int i;
   expdesc e;
   do {
     vidx = new_localvar(ls, str_checkname(ls));
-    kind = getlocalattribute(ls);
-    getlocalvardesc(fs, vidx)->vd.kind = kind;
+    var = getlocalvardesc(fs, vidx);
+    kind = getlocalattribute(ls, &var->vd.nt);
+    var->vd.kind = kind;
     if (kind == RDKTOCLOSE) {  /* to-be-closed? */
       if (toclose != -1)  /* one already present? */
         ecierthonK_semerror(ls, "multiple to-be-closed variables in local list");
@@ -1733,12 +2079,15 @@ static void localstat (LexState *ls) {
     }
     nvars++;
   } while (testnext(ls, ','));
-  if (testnext(ls, '='))
-    nexps = explist(ls, &e);
-  else {
-    e.k = VVOID;
-    nexps = 0;
+  if (testnext(ls, '=')) {  /* explist, with typed values */
+    expr(ls, &e);
+    for (nexps = 1; testnext(ls, ','); nexps++) {
+      localexp(fs, &e, localtype(fs, vidx, nvars, nexps));
+      expr(ls, &e);
+    }
   }
+  else
+    e.k = VVOID;
   var = getlocalvardesc(fs, vidx);  /* get last variable */
   if (nvars == nexps &&  /* no adjustments? */
       var->vd.kind == RDKCONST &&  /* last variable is const? */
@@ -1748,8 +2097,22 @@ static void localstat (LexState *ls) {
     fs->nactvar++;  /* but count it */
   }
   else {
+    if (nexps > 0 && !hasmultret(e.k))  /* last expression has one value? */
+      localexp(fs, &e, localtype(fs, vidx, nvars, nexps));
+    for (i = nexps + 1; i <= nvars; i++) {  /* variables without values */
+      if (localtype(fs, vidx, nvars, i) != NTANY && !hasmultret(e.k))
+        ecierthonK_semerror(ls, ecierthonO_pushfstring(ls->L,
+            "typed variable '%s' needs an initial value",
+            getstr(getlocalvardesc(fs, vidx - nvars + i)->vd.name)));
+    }
     adjust_assign(ls, nvars, nexps, &e);
     adjustlocalvars(ls, nvars);
+    for (i = (nexps > 0) ? nexps : 1; hasmultret(e.k) && i <= nvars; i++) {
+      var = getlocalvardesc(fs, vidx - nvars + i);  /* value from a call */
+      if (var->vd.nt != NTANY)
+        ecierthonK_codeABCk(fs, OP_CHECKTYPE, var->vd.sidx, var->vd.sidx, 0,
+                                              (var->vd.nt == NTFLT));
+    }
   }
   checktoclose(ls, toclose);
 }
@@ -1775,6 +2138,7 @@ static void funcstat (LexState *ls, int line) {
   expdesc v, b;
   ecierthonX_next(ls);  /* skip FUNCTION */
   ismethod = funcname(ls, &v);
+  markassigned(ls->fs, &v);
   body(ls, &b, ismethod, line);
   ecierthonK_storevar(ls->fs, &v, &b);
   ecierthonK_fixline(ls->fs, line);  /* definition "happens" in the first line */
@@ -1928,6 +2292,174 @@ static void mainfunc (LexState *ls, FuncState *fs) {
 }
 
 
+/*
+** {======================================================================
+** Data-only chunks: a single literal value (nil, booleans, numbers,
+** strings and table constructors of those), optionally preceded by
+** 'return', read straight into the value it denotes. No code is
+** generated, so constructors have no size limits; list items go
+** through the stack in batches, as in a regular constructor.
+** =======================================================================
+*/
+
+
+static void datavalue (LexState *ls);
+
+
+/*
+** Store the 'n' list items on the top of the stack into table 't',
+** after its first 'na' items, and pop them. The array part grows
+** geometrically, as the final size is not known in advance.
+*/
+static void dataflush (ecierthon_State *L, Table *t, unsigned int na, int n) {
+  unsigned int last = na + n;
+  unsigned int asize = ecierthonH_realasize(t);
+  StkId item = L->top - n;
+  int i;
+  if (last > asize)
+    ecierthonH_resizearray(L, t, (last > 2 * asize) ? last : 2 * asize);
+  for (i = 0; i < n; i++) {
+    TValue *val = s2v(item + i);
+    setobj2t(L, &t->array[na + i], val);
+    ecierthonC_barrierback(L, obj2gco(t), val);
+  }
+  L->top = item;
+}
+
+
+/*
+** Store the key-value pair on the top of the stack into table 't'
+** and pop it.
+*/
+static void dataset (LexState *ls, Table *t) {
+  ecierthon_State *L = ls->L;
+  TValue *key = s2v(L->top - 2);
+  TValue *val = s2v(L->top - 1);
+  TValue *slot;
+  if (ttisnil(key))
+    ecierthonX_syntaxerror(ls, "table index is nil");
+  slot = ecierthonH_set(L, t, key);
+  setobj2t(L, slot, val);
+  ecierthonC_barrierback(L, obj2gco(t), val);
+  L->top -= 2;
+}
+
+
+static void datatable (LexState *ls) {
+  ecierthon_State *L = ls->L;
+  int line = ls->linenumber;
+  unsigned int na = 0;  /* list items already stored */
+  int pending = 0;  /* list items waiting in the stack */
+  Table *t = ecierthonH_new(L);
+  sethvalue2s(L, L->top, t);  /* anchor it */
+  ecierthonD_inctop(L);
+  ecierthonC_checkGC(L);
+  checknext(ls, '{');
+  do {
+    if (ls->t.token == '}') break;
+    if (ls->t.token == TK_NAME) {  /* names are only field names */
+      ecierthonD_checkstack(L, 1);
+      setsvalue2s(L, L->top, str_checkname(ls));
+      L->top++;
+      checknext(ls, '=');
+      datavalue(ls);
+      dataset(ls, t);
+    }
+    else if (testnext(ls, '[')) {
+      datavalue(ls);
+      checknext(ls, ']');
+      checknext(ls, '=');
+      datavalue(ls);
+      dataset(ls, t);
+    }
+    else {
+      datavalue(ls);
+      if (++pending == LFIELDS_PER_FLUSH) {
+        dataflush(L, t, na, pending);
+        na += pending;
+        pending = 0;
+      }
+    }
+  } while (testnext(ls, ',') || testnext(ls, ';'));
+  check_match(ls, '}', '{', line);
+  if (pending > 0) {
+    dataflush(L, t, na, pending);
+    na += pending;
+  }
+  if (na < ecierthonH_realasize(t))  /* trim excess from growing */
+    ecierthonH_resizearray(L, t, na);
+  invalidateTMcache(t);  /* keys may name metamethods */
+}
+
+
+/*
+** Push the value of the literal starting at the current token.
+*/
+static void datavalue (LexState *ls) {
+  ecierthon_State *L = ls->L;
+  TValue *v;
+  if (ls->t.token == '{') {
+    enterlevel(ls);
+    datatable(ls);
+    leavelevel(ls);
+    return;
+  }
+  ecierthonD_checkstack(L, 1);
+  v = s2v(L->top);
+  switch (ls->t.token) {
+    case TK_NIL: setnilvalue(v); break;
+    case TK_TRUE: setbtvalue(v); break;
+    case TK_FALSE: setbfvalue(v); break;
+    case TK_INT: setivalue(v, ls->t.seminfo.i); break;
+    case TK_FLT: setfltvalue(v, ls->t.seminfo.r); break;
+    case TK_STRING: setsvalue(L, v, ls->t.seminfo.ts); break;
+    case '-': {
+      ecierthonX_next(ls);
+      if (ls->t.token == TK_INT) {
+        setivalue(v, l_castU2S(0u - l_castS2U(ls->t.seminfo.i)));
+      }
+      else if (ls->t.token == TK_FLT) {
+        setfltvalue(v, -ls->t.seminfo.r);
+      }
+      else
+        error_expected(ls, TK_FLT);
+      break;
+    }
+    default: ecierthonX_syntaxerror(ls, "unexpected symbol in data chunk");
+  }
+  L->top++;
+  ecierthonX_next(ls);
+}
+
+
+/*
+** Read a data-only chunk, leaving its value on the top of the stack.
+*/
+void ecierthonY_data (ecierthon_State *L, ZIO *z, Mbuffer *buff,
+                      const char *name, int firstchar) {
+  LexState lexstate;
+  TString *source;
+  lexstate.h = ecierthonH_new(L);  /* create table for scanner */
+  sethvalue2s(L, L->top, lexstate.h);  /* anchor it */
+  ecierthonD_inctop(L);
+  source = ecierthonS_new(L, name);
+  setsvalue2s(L, L->top, source);  /* anchor it */
+  ecierthonD_inctop(L);
+  lexstate.buff = buff;
+  lexstate.dyd = NULL;
+  ecierthonX_setinput(L, &lexstate, z, source, firstchar);
+  ecierthonX_next(&lexstate);  /* read first token */
+  testnext(&lexstate, TK_RETURN);
+  datavalue(&lexstate);
+  testnext(&lexstate, ';');
+  check(&lexstate, TK_EOS);
+  setobjs2s(L, L->top - 3, L->top - 1);  /* move value over the anchors */
+  L->top -= 2;
+}
+
+/* }====================================================================== */
+
+
 LClosure *ecierthonY_parser (ecierthon_State *L, ZIO *z, Mbuffer *buff,
                        Dyndata *dyd, const char *name, int firstchar) {
   LexState lexstate;
@@ -83,9 +83,17 @@ typedef struct expdesc {
   } u;
   int t;  /* patch list of 'exit when true' */
   int f;  /* patch list of 'exit when false' */
+  lu_byte nt;  /* static numeric type (for VLOCAL, VUPVAL, VNONRELOC
+                  and VRELOC) */
 } expdesc;
 
 
+/* static numeric types, from '<int>' and '<float>' variables */
+#define NTANY		0   /* any value */
+#define NTINT		1   /* always an integer */
+#define NTFLT		2   /* always a float */
+
+
 /* kinds of variables */
 #define VDKREG		0   /* regular */
 #define RDKCONST	1   /* constant */
@@ -99,6 +107,10 @@ typedef union Vardesc {
     lu_byte kind;
     lu_byte sidx;  /* index of the variable in the stack */
     short pidx;  /* index of the variable in the Proto's 'locvars' array */
+    lu_byte captured;  /* true if some closure uses the variable */
+    lu_byte assigned;  /* true if the variable is assigned after creation */
+    lu_byte nt;  /* numeric type from an '<int>'/'<float>' attribute */
+    int firstp;  /* first child prototype created in its scope */
     TString *name;  /* variable name */
   } vd;
   TValue k;  /* constant value (if any) */
@@ -140,18 +152,32 @@ typedef struct Dyndata {
 struct BlockCnt;  /* defined in lparser.c */
 
 
+/* maximum number of loads hoisted out of a numeric loop */
+#define MAXHOIST	4
+
+/* loads hoisted out of a numeric loop (see 'forbody' and OP_HOISTUP) */
+typedef struct LoopHoist {
+  int stamp;  /* slot in 'f->hoist' of the loop's stamp (-1 if none yet) */
+  int n;  /* number of hoisted loads */
+  int lastuse;  /* pc of last OP_GETHOIST */
+  Instruction load[MAXHOIST];  /* instructions that compute them */
+} LoopHoist;
+
+
 /* state needed to generate code for a given function */
 typedef struct FuncState {
   Proto *f;  /* current function header */
   struct FuncState *prev;  /* enclosing function */
   struct LexState *ls;  /* lexical state */
   struct BlockCnt *bl;  /* chain of current blocks */
+  LoopHoist *lh;  /* innermost loop with hoisted loads (or NULL) */
   int pc;  /* next position to code (equivalent to 'ncode') */
   int lasttarget;   /* 'label' of last 'jump label' */
   int previousline;  /* last line that was saved in 'lineinfo' */
   int nk;  /* number of elements in 'k' */
   int np;  /* number of elements in 'p' */
   int nabslineinfo;  /* number of elements in 'abslineinfo' */
+  int nhoist;  /* number of slots for hoisted loads (see 'hoistslot') */
   int firstlocal;  /* index of first local var (in Dyndata array) */
   int firstlabel;  /* index of first label (in 'dyd->label->arr') */
   short ndebugvars;  /* number of elements in 'f->locvars' */
@@ -166,6 +192,8 @@ typedef struct FuncState {
 ecierthonI_FUNC int ecierthonY_nvarstack (FuncState *fs);
 ecierthonI_FUNC LClosure *ecierthonY_parser (ecierthon_State *L, ZIO *z, Mbuffer *buff,
                                  Dyndata *dyd, const char *name, int firstchar);
+ecierthonI_FUNC void ecierthonY_data (ecierthon_State *L, ZIO *z, Mbuffer *buff,
+                                  const char *name, int firstchar);
 
 
 #endif
@@ -205,7 +205,7 @@ static void freestack (ecierthon_State *L) {
   L->ci = &L->base_ci;  /* free the entire 'ci' list */
   ecierthonE_freeCI(L);
   ecierthon_assert(L->nci == 0);
-  ecierthonM_freearray(L, L->stack, stacksize(L) + EXTRA_STACK);  /* free stack */
+  ecierthonD_freestack(L);  /* free stack */
 }
 
 
@@ -261,11 +261,15 @@ static void preinit_thread (ecierthon_State *L, global_State *g) {
   L->hookmask = 0;
   L->basehookcount = 0;
   L->allowhook = 1;
+  L->stackmapped = 0;
   resethookcount(L);
+  L->budgetf = NULL;
+  L->budget = MAX_LMEM;  /* no budget */
   L->openupval = NULL;
   L->status = ecierthon_OK;
   L->errfunc = 0;
   L->oldpc = 0;
+  L->nCyield = 0;
 }
 
 
@@ -273,9 +277,14 @@ static void close_state (ecierthon_State *L) {
   global_State *g = G(L);
   ecierthonF_close(L, L->stack, CLOSEPROTECT);  /* close all upvalues */
   ecierthonC_freeallobjects(L);  /* collect all objects */
+  g->GCdebt -= cast(l_mem, g->GCextbytes);  /* external bytes never released */
+  g->GCextbytes = 0;
   if (ttisnil(&g->nilvalue))  /* closing a fully built state? */
     ecierthoni_userstateclose(L);
   ecierthonM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
+  ecierthonM_freearray(L, g->threadpool, g->poolsize);
+  if (g->opprofile != NULL)
+    ecierthonM_free(L, g->opprofile);
   freestack(L);
   ecierthon_assert(gettotalbytes(g) == sizeof(LG));
   (*g->frealloc)(g->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
@@ -288,18 +297,30 @@ ecierthon_API ecierthon_State *ecierthon_newthread (ecierthon_State *L) {
   ecierthon_lock(L);
   g = G(L);
   ecierthonC_checkGC(L);
-  /* create new thread */
-  L1 = &cast(LX *, ecierthonM_newobject(L, ecierthon_TTHREAD, sizeof(LX)))->l;
-  L1->marked = ecierthonC_white(g);
-  L1->tt = ecierthon_VTHREAD;
-  /* link it on list 'allgc' */
-  L1->next = g->allgc;
-  g->allgc = obj2gco(L1);
+  if (g->poolcount > 0) {  /* reuse a released thread? */
+    L1 = g->threadpool[--g->poolcount];
+    ecierthon_assert(L1->ci == &L1->base_ci && L1->status == ecierthon_OK);
+    g->poolreused++;
+  }
+  else {  /* create new thread */
+    L1 = &cast(LX *, ecierthonM_newobject(L, ecierthon_TTHREAD, sizeof(LX)))->l;
+    L1->marked = ecierthonC_white(g);
+    L1->tt = ecierthon_VTHREAD;
+    /* link it on list 'allgc' */
+    L1->next = g->allgc;
+    g->allgc = obj2gco(L1);
+    preinit_thread(L1, g);
+    g->poolcreated++;
+    if (g->poolsize < g->poollimit) {  /* make room for collected threads */
+      g->threadpool = ecierthonM_reallocvector(L, g->threadpool, g->poolsize,
+                                         g->poollimit, ecierthon_State *);
+      g->poolsize = g->poollimit;
+    }
+  }
   /* anchor it on L stack */
   setthvalue2s(L, L->top, L1);
   api_incr_top(L);
-  preinit_thread(L1, g);
-  L1->nCcalls = 0;
+  L1->nCcalls = L1->nCyield = 0;
   L1->hookmask = L->hookmask;
   L1->basehookcount = L->basehookcount;
   L1->hook = L->hook;
@@ -307,8 +328,10 @@ ecierthon_API ecierthon_State *ecierthon_newthread (ecierthon_State *L) {
   /* initialize L1 extra space */
   memcpy(ecierthon_getextraspace(L1), ecierthon_getextraspace(g->mainthread),
          ecierthon_EXTRASPACE);
-  ecierthoni_userstatethread(L, L1);
-  stack_init(L1, L);  /* init stack */
+  if (L1->stack == NULL) {  /* new thread? */
+    ecierthoni_userstatethread(L, L1);
+    stack_init(L1, L);  /* init stack */
+  }
   ecierthon_unlock(L);
   return L1;
 }
@@ -346,6 +369,117 @@ int ecierthon_resetthread (ecierthon_State *L) {
 }
 
 
+/*
+** {======================================================
+** Thread pool: dead threads keep their stacks and CallInfo lists and
+** are handed out again by 'ecierthon_newthread'. Threads get there
+** from the collector, which recycles unreachable threads instead of
+** freeing them, or from 'ecierthon_releasethread', whose caller
+** vouches that nothing else refers to the thread. Either way, no one
+** can see the same object live twice. The collector marks pooled
+** threads (see 'markthreadpool' in lgc.c) and still trims their stacks
+** and CallInfo lists as usual.
+** =======================================================
+*/
+
+/*
+** Put thread 'co', with an empty stack, in the pool.
+*/
+static void poolthread (global_State *g, ecierthon_State *co) {
+  co->errorJmp = NULL;
+  co->errfunc = 0;
+  co->oldpc = 0;
+  co->allowhook = 1;
+  co->budgetf = NULL;
+  co->budget = MAX_LMEM;
+  co->base_ci.u.c.k = NULL;
+  co->base_ci.nresults = 0;
+  g->threadpool[g->poolcount++] = co;
+}
+
+
+/*
+** Called by the collector for a dead thread 'L1'. If it has nothing
+** left to close and the pool has room, empty its stack and keep it in
+** the pool instead of freeing it. (It must not allocate memory nor
+** run any code.)
+*/
+int ecierthonE_recyclethread (global_State *g, ecierthon_State *L1) {
+  StkId o;
+  if (g->poolcount >= g->poolsize || g->poolcount >= g->poollimit ||
+      L1->status != ecierthon_OK || L1->ci != &L1->base_ci ||
+      L1->openupval != NULL || L1->stack == NULL)
+    return 0;  /* let the collector free it */
+  ecierthon_assert(L1 != g->mainthread && L1->twups == L1);
+  for (o = L1->stack; o < L1->stack_last + EXTRA_STACK; o++)
+    setnilvalue(s2v(o));  /* its values may be dead (and freed) too */
+  L1->top = L1->stack + 1;
+  L1->base_ci.func = L1->stack;
+  L1->base_ci.callstatus = CIST_C;
+  L1->base_ci.top = L1->top + ecierthon_MINSTACK;
+  poolthread(g, L1);
+  g->poolcollected++;
+  return 1;
+}
+
+
+ecierthon_API int ecierthon_releasethread (ecierthon_State *L, ecierthon_State *co) {
+  global_State *g = G(L);
+  int status;
+  api_check(L, co != L && co != g->mainthread, "cannot release a running thread");
+  api_check(L, co->status != ecierthon_OK || co->ci == &co->base_ci,
+                "cannot release an active thread");
+  status = ecierthon_resetthread(co);
+  ecierthon_lock(L);
+  if (status != ecierthon_OK)  /* error closing variables? */
+    g->pooldropped++;  /* keep error object in 'co' */
+  else if (g->poolcount >= g->poollimit)  /* pool is full? */
+    g->pooldropped++;
+  else {
+    if (g->poolcount >= g->poolsize)
+      ecierthonM_growvector(L, g->threadpool, g->poolcount, g->poolsize,
+                      ecierthon_State *, MAX_INT, "pooled threads");
+    poolthread(g, co);
+  }
+  ecierthon_unlock(L);
+  return status;
+}
+
+
+ecierthon_API int ecierthon_setpoollimit (ecierthon_State *L, int limit) {
+  global_State *g = G(L);
+  int res;
+  ecierthon_lock(L);
+  res = g->poollimit;
+  if (limit >= 0) {
+    g->poollimit = limit;
+    if (g->poolcount > limit) {  /* drop excess threads */
+      g->pooldropped += g->poolcount - limit;
+      g->poolcount = limit;
+    }
+    if (g->poolsize > limit)
+      ecierthonM_shrinkvector(L, g->threadpool, g->poolsize, limit, ecierthon_State *);
+  }
+  ecierthon_unlock(L);
+  return res;
+}
+
+
+ecierthon_API void ecierthon_poolstats (ecierthon_State *L, ecierthon_PoolStats *s) {
+  global_State *g = G(L);
+  ecierthon_lock(L);
+  s->count = cast_sizet(g->poolcount);
+  s->limit = cast_sizet(g->poollimit);
+  s->reused = cast_sizet(g->poolreused);
+  s->created = cast_sizet(g->poolcreated);
+  s->dropped = cast_sizet(g->pooldropped);
+  s->collected = cast_sizet(g->poolcollected);
+  ecierthon_unlock(L);
+}
+
+/* }====================================================== */
+
+
 ecierthon_API ecierthon_State *ecierthon_newstate (ecierthon_Alloc f, void *ud) {
   int i;
   ecierthon_State *L;
@@ -365,6 +499,11 @@ ecierthon_API ecierthon_State *ecierthon_newstate (ecierthon_Alloc f, void *ud)
   g->frealloc = f;
   g->ud = ud;
   g->warnf = NULL;
+  g->selectf = NULL;
+  g->interruptf = NULL;
+  g->interrupt = 0;
+  g->opprofile = NULL;
+  g->opprofiling = 0;
   g->ud_warn = NULL;
   g->mainthread = L;
   g->seed = ecierthoni_makeseed(L);
@@ -383,9 +522,22 @@ ecierthon_API ecierthon_State *ecierthon_newstate (ecierthon_Alloc f, void *ud)
   g->gray = g->grayagain = NULL;
   g->weak = g->ephemeron = g->allweak = NULL;
   g->twups = NULL;
+  g->threadpool = NULL;
+  g->poolcount = g->poolsize = 0;
+  g->poollimit = ecierthonI_THREADPOOL;
+  g->poolreused = g->poolcreated = g->pooldropped = g->poolcollected = 0;
+  g->hoistepoch = 0;
+  g->resepoch = 0;
   g->totalbytes = sizeof(LG);
   g->GCdebt = 0;
+  g->GCextbytes = 0;
   g->lastatomic = 0;
+  g->GCminorbase = 0;
+  g->gcadapt = 0;
+  g->gcadaptbad = g->gcadaptcycles = 0;
+  g->gcadaptretry = 1;
+  g->gcpretenure = 0;
+  g->sampledsites = g->pretenured = NULL;
   setivalue(&g->nilvalue, 0);  /* to signal that state is not yet built */
   setgcparam(g->gcpause, ecierthonI_GCPAUSE);
   setgcparam(g->gcstepmul, ecierthonI_GCMUL);
@@ -10,6 +10,7 @@
 #include "ecierthon.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "ltm.h"
 #include "lzio.h"
 
@@ -139,6 +140,11 @@ struct ecierthon_longjmp;  /* defined in ldo.c */
 
 #define BASIC_STACK_SIZE        (2*ecierthon_MINSTACK)
 
+/* default maximum number of released threads kept for reuse */
+#if !defined(ecierthonI_THREADPOOL)
+#define ecierthonI_THREADPOOL	64
+#endif
+
 #define stacksize(th)	cast_int((th)->stack_last - (th)->stack)
 
 
@@ -213,6 +219,18 @@ typedef struct CallInfo {
 #define getoah(st)	((st) & CIST_OAH)
 
 
+/*
+** Counts of the opcode profiler (see 'ecierthon_opprofile'): 'pair[a][b]'
+** counts opcode 'b' executed right after opcode 'a'; row NUM_OPCODES
+** is for the first opcode counted, which has no predecessor.
+*/
+typedef struct OpProfile {
+  lu_mem op[NUM_OPCODES];
+  lu_mem pair[NUM_OPCODES + 1][NUM_OPCODES];
+  int last;  /* last opcode counted */
+} OpProfile;
+
+
 /*
 ** 'global state', shared by all threads of this state
 */
@@ -221,8 +239,11 @@ typedef struct global_State {
   void *ud;         /* auxiliary data to 'frealloc' */
   l_mem totalbytes;  /* number of bytes currently allocated - GCdebt */
   l_mem GCdebt;  /* bytes allocated not yet compensated by the collector */
+  lu_mem GCextbytes;  /* external bytes declared by the host (in 'GCdebt') */
   lu_mem GCestimate;  /* an estimate of the non-garbage memory in use */
   lu_mem lastatomic;  /* see function 'genstep' in file 'lgc.c' */
+  lu_mem GCminorbase;  /* memory in use after last minor collection */
+  l_mem gcadapt;  /* target pause (microseconds) in adaptive mode, or 0 */
   stringtable strt;  /* hash table for strings */
   TValue l_registry;
   TValue nilvalue;  /* a nil value */
@@ -237,6 +258,10 @@ typedef struct global_State {
   lu_byte gcpause;  /* size of pause between successive GCs */
   lu_byte gcstepmul;  /* GC "speed" */
   lu_byte gcstepsize;  /* (log2 of) GC granularity */
+  lu_byte gcadaptbad;  /* bad collections in a row (adaptive mode) */
+  lu_byte gcadaptcycles;  /* inc. cycles before retrying generational mode */
+  lu_byte gcadaptretry;  /* wait to use after next failed generational try */
+  lu_byte gcpretenure;  /* true if allocation sites are tracked */
   GCObject *allgc;  /* list of all collectable objects */
   GCObject **sweepgc;  /* current position of sweep in list */
   GCObject *finobj;  /* list of collectable objects with finalizers */
@@ -255,8 +280,25 @@ typedef struct global_State {
   GCObject *finobjsur;  /* list of survival objects with finalizers */
   GCObject *finobjold1;  /* list of old1 objects with finalizers */
   GCObject *finobjrold;  /* list of really old objects with finalizers */
+  AllocSite *sampledsites;  /* sites following a young object */
+  AllocSite *pretenured;  /* sites creating old objects */
   struct ecierthon_State *twups;  /* list of threads with open upvalues */
+  struct ecierthon_State **threadpool;  /* released threads ready for reuse */
+  int poolcount;  /* number of threads in 'threadpool' */
+  int poolsize;  /* size of array 'threadpool' */
+  int poollimit;  /* maximum number of pooled threads */
+  lu_mem poolreused;  /* threads taken from the pool */
+  lu_mem poolcreated;  /* threads created anew */
+  lu_mem pooldropped;  /* released threads left to the collector */
+  lu_mem poolcollected;  /* dead threads recycled by the collector */
+  lu_mem hoistepoch;  /* changes to watched tables (see OP_HOISTUP) */
+  lu_mem resepoch;  /* changes to resources outside the allocator */
   ecierthon_CFunction panic;  /* to be called in unprotected errors */
+  ecierthon_CFunction selectf;  /* standard 'select' (see OP_SELECT) */
+  ecierthon_Interrupt interruptf;  /* called for a pending interrupt */
+  volatile l_signalT interrupt;  /* pending interrupt code, or 0 */
+  OpProfile *opprofile;  /* opcode counts, or NULL */
+  lu_byte opprofiling;  /* true if the VM is counting opcodes */
   struct ecierthon_State *mainthread;
   TString *memerrmsg;  /* message for memory-allocation errors */
   TString *tmname[TM_N];  /* array with tag-method names */
@@ -274,6 +316,7 @@ struct ecierthon_State {
   CommonHeader;
   lu_byte status;
   lu_byte allowhook;
+  lu_byte stackmapped;  /* true if stack has its own mapping */
   unsigned short nci;  /* number of items in 'ci' list */
   StkId top;  /* first free slot in the stack */
   global_State *l_G;
@@ -288,10 +331,13 @@ struct ecierthon_State {
   volatile ecierthon_Hook hook;
   ptrdiff_t errfunc;  /* current error handling function (stack index) */
   l_uint32 nCcalls;  /* number of nested (non-yieldable | C)  calls */
+  l_uint32 nCyield;  /* 'nCcalls' where a yield can return (see ldo.c) */
   int oldpc;  /* last pc traced */
   int basehookcount;
   int hookcount;
   volatile l_signalT hookmask;
+  ecierthon_Hook budgetf;  /* called when 'budget' runs out */
+  l_mem budget;  /* safepoints left before calling 'budgetf' */
 };
 
 
@@ -347,11 +393,18 @@ union GCUnion {
 #define obj2gco(v)	check_exp((v)->tt >= ecierthon_TSTRING, &(cast_u(v)->gc))
 
 
-/* actual number of total bytes allocated */
+/*
+** number of total bytes allocated, plus the external bytes declared
+** by the host, which count for the pace of the collector
+*/
 #define gettotalbytes(g)	cast(lu_mem, (g)->totalbytes + (g)->GCdebt)
 
+/* actual number of bytes allocated by the state */
+#define getheapbytes(g)		(gettotalbytes(g) - (g)->GCextbytes)
+
 ecierthonI_FUNC void ecierthonE_setdebt (global_State *g, l_mem debt);
 ecierthonI_FUNC void ecierthonE_freethread (ecierthon_State *L, ecierthon_State *L1);
+ecierthonI_FUNC int ecierthonE_recyclethread (global_State *g, ecierthon_State *L1);
 ecierthonI_FUNC CallInfo *ecierthonE_extendCI (ecierthon_State *L);
 ecierthonI_FUNC void ecierthonE_freeCI (ecierthon_State *L);
 ecierthonI_FUNC void ecierthonE_shrinkCI (ecierthon_State *L);
@@ -264,6 +264,7 @@ Udata *ecierthonS_newudata (ecierthon_State *L, size_t s, int nuvalue) {
   o = ecierthonC_newobj(L, ecierthon_VUSERDATA, sizeudata(nuvalue, s));
   u = gco2u(o);
   u->len = s;
+  u->extsize = 0;
   u->nuvalue = nuvalue;
   u->metatable = NULL;
   for (i = 0; i < nuvalue; i++)
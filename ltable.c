@@ -25,6 +25,7 @@
 
 #include <math.h>
 #include <limits.h>
+#include <string.h>
 
 #include "ecierthon.h"
 
@@ -605,6 +606,48 @@ Table *ecierthonH_new (ecierthon_State *L) {
 }
 
 
+/*
+** Replace the template in 'slot' of table 't' by a copy of it.
+*/
+static void copynested (ecierthon_State *L, Table *t, TValue *slot) {
+  Table *tmpl = hvalue(slot);
+  Table *nt = ecierthonH_new(L);
+  sethvalue(L, slot, nt);  /* anchor the copy in 't' */
+  ecierthonC_barrierback(L, obj2gco(t), slot);
+  ecierthonH_copy(L, nt, tmpl);
+}
+
+
+/*
+** Fill the new table 't' (which must be anchored) with a copy of
+** template 'tmpl', a table built by the compiler from a constructor
+** with only constant fields. Both parts are copied as they are, with
+** the same sizes and layout ('gnext' offsets are relative). Table
+** values in a template are templates too, and are copied in turn.
+*/
+void ecierthonH_copy (ecierthon_State *L, Table *t, Table *tmpl) {
+  unsigned int asize = ecierthonH_realasize(tmpl);
+  unsigned int size = isdummy(tmpl) ? 0 : cast_uint(sizenode(tmpl));
+  unsigned int i;
+  ecierthonH_resize(L, t, asize, size);
+  invalidateTMcache(t);  /* copied keys may name metamethods */
+  if (asize > 0)
+    memcpy(t->array, tmpl->array, asize * sizeof(TValue));
+  if (size > 0) {
+    memcpy(gnode(t, 0), gnode(tmpl, 0), size * sizeof(Node));
+    t->lastfree = gnode(t, tmpl->lastfree - gnode(tmpl, 0));
+  }
+  for (i = 0; i < asize; i++) {
+    if (ttistable(&t->array[i]))
+      copynested(L, t, &t->array[i]);
+  }
+  for (i = 0; i < size; i++) {
+    if (ttistable(gval(gnode(t, i))))
+      copynested(L, t, gval(gnode(t, i)));
+  }
+}
+
+
 void ecierthonH_free (ecierthon_State *L, Table *t) {
   freehash(L, t);
   ecierthonM_freearray(L, t->array, ecierthonH_realasize(t));
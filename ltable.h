@@ -23,6 +23,14 @@
 #define invalidateTMcache(t)	((t)->flags &= ~maskflags)
 
 
+/*
+** Signal a change to table 't'. If some hoisted load has read it, move
+** the hoisting epoch, so that all hoisted values are loaded again.
+*/
+#define ecierthonH_touch(L,t)  \
+	{ if (unlikely(iswatched(t))) G(L)->hoistepoch++; }
+
+
 /* true when 't' is using 'dummynode' as its hash part */
 #define isdummy(t)		((t)->lastfree == NULL)
 
@@ -44,6 +52,7 @@ ecierthonI_FUNC const TValue *ecierthonH_get (Table *t, const TValue *key);
 ecierthonI_FUNC TValue *ecierthonH_newkey (ecierthon_State *L, Table *t, const TValue *key);
 ecierthonI_FUNC TValue *ecierthonH_set (ecierthon_State *L, Table *t, const TValue *key);
 ecierthonI_FUNC Table *ecierthonH_new (ecierthon_State *L);
+ecierthonI_FUNC void ecierthonH_copy (ecierthon_State *L, Table *t, Table *tmpl);
 ecierthonI_FUNC void ecierthonH_resize (ecierthon_State *L, Table *t, unsigned int nasize,
                                                     unsigned int nhsize);
 ecierthonI_FUNC void ecierthonH_resizearray (ecierthon_State *L, Table *t, unsigned int nasize);
@@ -268,3 +268,47 @@ void ecierthonT_getvarargs (ecierthon_State *L, CallInfo *ci, StkId where, int w
     setnilvalue(s2v(where + i));
 }
 
+
+/*
+** Put the results of 'select(n, ...)' in 'where', taking them straight
+** from the vararg area ('wanted' < 0 means all results). Returns 0,
+** doing nothing, when 'n' is not an integer or '#' or is out of range,
+** so that the real 'select' handles (and reports) it.
+*/
+int ecierthonT_selectvarargs (ecierthon_State *L, CallInfo *ci, StkId where,
+                              const TValue *n, int wanted) {
+  int i;
+  int nextra = ci->u.l.nextraargs;
+  if (ttisstring(n) && *svalue(n) == '#') {
+    if (wanted < 0) {
+      wanted = 1;
+      L->top = where + 1;  /* next instruction will need top */
+    }
+    setivalue(s2v(where), nextra);
+    for (i = 1; i < wanted; i++)
+      setnilvalue(s2v(where + i));
+  }
+  else if (ttisinteger(n)) {
+    ecierthon_Integer k = ivalue(n);  /* index of first result, counting 'n' */
+    StkId first;
+    if (k < 0) k += nextra + 1;
+    else if (k > nextra + 1) k = nextra + 1;
+    if (k < 1)
+      return 0;  /* index out of range */
+    nextra -= cast_int(k) - 1;  /* number of results */
+    if (wanted < 0) {
+      wanted = nextra;
+      checkstackGCp(L, nextra, where);  /* ensure stack space */
+      L->top = where + nextra;  /* next instruction will need top */
+    }
+    first = ci->func - nextra;
+    for (i = 0; i < wanted && i < nextra; i++)
+      setobjs2s(L, where + i, first + i);
+    for (; i < wanted; i++)   /* complete required results with nil */
+      setnilvalue(s2v(where + i));
+  }
+  else
+    return 0;
+  return 1;
+}
+
@@ -98,6 +98,8 @@ ecierthonI_FUNC void ecierthonT_adjustvarargs (ecierthon_State *L, int nfixparam
                                    struct CallInfo *ci, const Proto *p);
 ecierthonI_FUNC void ecierthonT_getvarargs (ecierthon_State *L, struct CallInfo *ci,
                                               StkId where, int wanted);
+ecierthonI_FUNC int ecierthonT_selectvarargs (ecierthon_State *L, struct CallInfo *ci,
+                                  StkId where, const TValue *n, int wanted);
 
 
 #endif
@@ -21,6 +21,7 @@
 #include "lmem.h"
 #include "lobject.h"
 #include "lstring.h"
+#include "ltable.h"
 #include "lundump.h"
 #include "lzio.h"
 
@@ -34,6 +35,8 @@ typedef struct {
   ecierthon_State *L;
   ZIO *Z;
   const char *name;
+  ecierthon_Shared *shared;  /* block with code and line info. (or NULL) */
+  int nproto;  /* next prototype in 'shared' */
 } LoadState;
 
 
@@ -141,17 +144,99 @@ static TString *loadString (LoadState *S, Proto *p) {
 }
 
 
+/*
+** Prototype 'f' takes its code and line information from the next
+** prototype in the shared block; the dump has only their sizes.
+*/
+static void loadShared (LoadState *S, Proto *f) {
+  ecierthon_Shared *s = S->shared;
+  SharedProto *sp;
+  if (S->nproto >= s->nprotos)
+    error(S, "corrupted shared chunk");
+  sp = &s->protos[S->nproto++];
+  ecierthoni_atomicinc(s->refcount);
+  f->shared = s;
+  f->code = sp->code;
+  f->lineinfo = sp->lineinfo;
+  f->abslineinfo = sp->abslineinfo;
+}
+
+
 static void loadCode (LoadState *S, Proto *f) {
   int n = loadInt(S);
-  f->code = ecierthonM_newvectorchecked(S->L, n, Instruction);
-  f->sizecode = n;
-  loadVector(S, f->code, n);
+  if (f->shared)  /* code already in place? */
+    f->sizecode = n;
+  else {
+    f->code = ecierthonM_newvectorchecked(S->L, n, Instruction);
+    f->sizecode = n;
+    loadVector(S, f->code, n);
+  }
 }
 
 
 static void loadFunction(LoadState *S, Proto *f, TString *psource);
 
 
+static void loadConstant (LoadState *S, Proto *f, TValue *o);
+
+
+/*
+** Load a table constant into 'o' (which must be anchored). Keys and
+** values are loaded into the stack before going into the table.
+*/
+static void loadTable (LoadState *S, Proto *f, TValue *o) {
+  ecierthon_State *L = S->L;
+  int n = loadInt(S);
+  Table *t = ecierthonH_new(L);
+  sethvalue(L, o, t);
+  ecierthonC_objbarrier(L, f, t);
+  while (n-- > 0) {
+    TValue *slot;
+    setnilvalue(s2v(L->top));  /* room for key */
+    ecierthonD_inctop(L);
+    setnilvalue(s2v(L->top));  /* room for value */
+    ecierthonD_inctop(L);
+    loadConstant(S, f, s2v(L->top - 2));
+    loadConstant(S, f, s2v(L->top - 1));
+    slot = ecierthonH_set(L, t, s2v(L->top - 2));  /* checks the key */
+    setobj(L, slot, s2v(L->top - 1));
+    ecierthonC_barrierback(L, obj2gco(t), s2v(L->top - 2));
+    ecierthonC_barrierback(L, obj2gco(t), s2v(L->top - 1));
+    L->top -= 2;
+  }
+}
+
+
+static void loadConstant (LoadState *S, Proto *f, TValue *o) {
+  int t = loadByte(S);
+  switch (t) {
+    case ecierthon_VNIL:
+      setnilvalue(o);
+      break;
+    case ecierthon_VFALSE:
+      setbfvalue(o);
+      break;
+    case ecierthon_VTRUE:
+      setbtvalue(o);
+      break;
+    case ecierthon_VNUMFLT:
+      setfltvalue(o, loadNumber(S));
+      break;
+    case ecierthon_VNUMINT:
+      setivalue(o, loadInteger(S));
+      break;
+    case ecierthon_VSHRSTR:
+    case ecierthon_VLNGSTR:
+      setsvalue2n(S->L, o, loadString(S, f));
+      break;
+    case ecierthon_VTABLE:
+      loadTable(S, f, o);
+      break;
+    default: ecierthon_assert(0);
+  }
+}
+
+
 static void loadConstants (LoadState *S, Proto *f) {
   int i;
   int n = loadInt(S);
@@ -159,32 +244,8 @@ static void loadConstants (LoadState *S, Proto *f) {
   f->sizek = n;
   for (i = 0; i < n; i++)
     setnilvalue(&f->k[i]);
-  for (i = 0; i < n; i++) {
-    TValue *o = &f->k[i];
-    int t = loadByte(S);
-    switch (t) {
-      case ecierthon_VNIL:
-        setnilvalue(o);
-        break;
-      case ecierthon_VFALSE:
-        setbfvalue(o);
-        break;
-      case ecierthon_VTRUE:
-        setbtvalue(o);
-        break;
-      case ecierthon_VNUMFLT:
-        setfltvalue(o, loadNumber(S));
-        break;
-      case ecierthon_VNUMINT:
-        setivalue(o, loadInteger(S));
-        break;
-      case ecierthon_VSHRSTR:
-      case ecierthon_VLNGSTR:
-        setsvalue2n(S->L, o, loadString(S, f));
-        break;
-      default: ecierthon_assert(0);
-    }
-  }
+  for (i = 0; i < n; i++)
+    loadConstant(S, f, &f->k[i]);
 }
 
 
@@ -214,12 +275,15 @@ static void loadUpvalues (LoadState *S, Proto *f) {
   n = loadInt(S);
   f->upvalues = ecierthonM_newvectorchecked(S->L, n, Upvaldesc);
   f->sizeupvalues = n;
-  for (i = 0; i < n; i++)  /* make array valid for GC */
+  for (i = 0; i < n; i++) {  /* make array valid for GC */
     f->upvalues[i].name = NULL;
+    f->upvalues[i].flat = 0;
+  }
   for (i = 0; i < n; i++) {  /* following calls can raise errors */
     f->upvalues[i].instack = loadByte(S);
     f->upvalues[i].idx = loadByte(S);
     f->upvalues[i].kind = loadByte(S);
+    f->upvalues[i].flat = loadByte(S);
   }
 }
 
@@ -227,15 +291,23 @@ static void loadUpvalues (LoadState *S, Proto *f) {
 static void loadDebug (LoadState *S, Proto *f) {
   int i, n;
   n = loadInt(S);
-  f->lineinfo = ecierthonM_newvectorchecked(S->L, n, ls_byte);
-  f->sizelineinfo = n;
-  loadVector(S, f->lineinfo, n);
+  if (f->shared)  /* line information already in place? */
+    f->sizelineinfo = n;
+  else {
+    f->lineinfo = ecierthonM_newvectorchecked(S->L, n, ls_byte);
+    f->sizelineinfo = n;
+    loadVector(S, f->lineinfo, n);
+  }
   n = loadInt(S);
-  f->abslineinfo = ecierthonM_newvectorchecked(S->L, n, AbsLineInfo);
-  f->sizeabslineinfo = n;
-  for (i = 0; i < n; i++) {
-    f->abslineinfo[i].pc = loadInt(S);
-    f->abslineinfo[i].line = loadInt(S);
+  if (f->shared)
+    f->sizeabslineinfo = n;
+  else {
+    f->abslineinfo = ecierthonM_newvectorchecked(S->L, n, AbsLineInfo);
+    f->sizeabslineinfo = n;
+    for (i = 0; i < n; i++) {
+      f->abslineinfo[i].pc = loadInt(S);
+      f->abslineinfo[i].line = loadInt(S);
+    }
   }
   n = loadInt(S);
   f->locvars = ecierthonM_newvectorchecked(S->L, n, LocVar);
@@ -262,6 +334,8 @@ static void loadFunction (LoadState *S, Proto *f, TString *psource) {
   f->numparams = loadByte(S);
   f->is_vararg = loadByte(S);
   f->maxstacksize = loadByte(S);
+  if (S->shared)
+    loadShared(S, f);
   loadCode(S, f);
   loadConstants(S, f);
   loadUpvalues(S, f);
@@ -306,9 +380,11 @@ static void checkHeader (LoadState *S) {
 
 
 /*
-** Load precompiled chunk.
+** Load precompiled chunk. With a 'shared' block, the chunk is a dump
+** of that block and its prototypes use the block's code.
 */
-LClosure *ecierthonU_undump(ecierthon_State *L, ZIO *Z, const char *name) {
+LClosure *ecierthonU_undump(ecierthon_State *L, ZIO *Z, const char *name,
+                      ecierthon_Shared *shared) {
   LoadState S;
   LClosure *cl;
   if (*name == '@' || *name == '=')
@@ -319,6 +395,8 @@ LClosure *ecierthonU_undump(ecierthon_State *L, ZIO *Z, const char *name) {
     S.name = name;
   S.L = L;
   S.Z = Z;
+  S.shared = shared;
+  S.nproto = 0;
   checkHeader(&S);
   cl = ecierthonF_newLclosure(L, loadByte(&S));
   setclLvalue2s(L, L->top, cl);
@@ -24,13 +24,14 @@
 #define MYINT(s)	(s[0]-'0')  /* assume one-digit numerals */
 #define ecierthonC_VERSION	(MYINT(ecierthon_VERSION_MAJOR)*16+MYINT(ecierthon_VERSION_MINOR))
 
-#define ecierthonC_FORMAT	0	/* this is the official format */
+#define ecierthonC_FORMAT	1	/* official format plus flat-upvalue flags */
 
 /* load one chunk; from lundump.c */
-ecierthonI_FUNC LClosure* ecierthonU_undump (ecierthon_State* L, ZIO* Z, const char* name);
+ecierthonI_FUNC LClosure* ecierthonU_undump (ecierthon_State* L, ZIO* Z, const char* name,
+                                 ecierthon_Shared *shared);
 
 /* dump one chunk; from ldump.c */
 ecierthonI_FUNC int ecierthonU_dump (ecierthon_State* L, const Proto* f, ecierthon_Writer w,
-                         void* data, int strip);
+                         void* data, int strip, int shared);
 
 #endif
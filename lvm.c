@@ -341,6 +341,7 @@ void ecierthonV_finishset (ecierthon_State *L, const TValue *t, TValue *key,
           slot = ecierthonH_newkey(L, h, key);  /* create one */
         /* no metamethod and (now) there is an entry with given key */
         setobj2t(L, cast(TValue *, slot), val);  /* set its new value */
+        ecierthonH_touch(L, h);
         invalidateTMcache(h);
         ecierthonC_barrierback(L, obj2gco(h), val);
         return;
@@ -368,6 +369,52 @@ void ecierthonV_finishset (ecierthon_State *L, const TValue *t, TValue *key,
 }
 
 
+/*
+** Create the slots for the values hoisted out of the loops of 'p',
+** as many as its hoisted loads name (see 'hoistslot' in lcode.c).
+*/
+static void createhoist (ecierthon_State *L, Proto *p) {
+  int pc, n = 0;
+  TValue *hoist;
+  for (pc = 0; pc < p->sizecode; pc++) {
+    Instruction i = p->code[pc];
+    OpCode op = GET_OPCODE(i);
+    int top = GETARG_A(i) + 1 + (op == OP_HOISTDONE);  /* stamp is 2 slots */
+    if ((op == OP_HOISTUP || op == OP_HOISTFIELD || op == OP_HOISTDONE) &&
+        top > n)
+      n = top;
+  }
+  hoist = ecierthonM_newvector(L, n, TValue);
+  for (pc = 0; pc < n; pc++)
+    setnilvalue(&hoist[pc]);
+  p->hoist = hoist;
+  p->sizehoist = n;
+}
+
+
+/*
+** Raw read of 't[key]' into slot 'res' of 'p' for a hoisted load (see
+** OP_HOISTUP). It never calls metamethods: when 't' is not a table or
+** has no such key, the result is nil and the uses of this load run
+** their ordinary code. A table read here becomes watched, so that any
+** change to it invalidates the hoisted values.
+*/
+static void hoistget (ecierthon_State *L, Proto *p, TValue *res,
+                      const TValue *t, TString *key) {
+  if (ttistable(t)) {
+    Table *h = hvalue(t);
+    const TValue *slot = ecierthonH_getshortstr(h, key);
+    setwatched(h);
+    if (!isempty(slot)) {
+      setobj(L, res, slot);
+      ecierthonC_barrier(L, p, res);
+      return;
+    }
+  }
+  setnilvalue(res);
+}
+
+
 /*
 ** Compare two strings 'ls' x 'rs', returning an integer less-equal-
 ** -greater than zero if 'ls' is less-equal-greater than 'rs'.
@@ -778,12 +825,62 @@ ecierthon_Integer ecierthonV_shiftl (ecierthon_Integer x, ecierthon_Integer y) {
 }
 
 
+/*
+** Check whether flat upvalues 'v1' and 'v2' hold the same value: the
+** same variant and a raw-equal value, except that floats must have the
+** same bits ('0.0' and '-0.0' are equal but not the same value, and a
+** NaN is not equal even to itself).
+*/
+static int sameflat (const TValue *v1, const TValue *v2) {
+  if (rawtt(v1) != rawtt(v2))
+    return 0;
+  else if (ttisfloat(v1)) {
+    ecierthon_Number n1 = fltvalue(v1), n2 = fltvalue(v2);
+    return (memcmp(&n1, &n2, sizeof(n1)) == 0);
+  }
+  else
+    return ecierthonV_rawequalobj(v1, v2);
+}
+
+
+/*
+** check whether cached closure in prototype 'p' may be reused, that is,
+** whether there is a cached closure with the same upvalues needed by
+** new closure to be created: the same UpVal for a regular upvalue, the
+** same value for a flat one.
+*/
+static LClosure *getcached (Proto *p, UpValSlot *encup, StkId base) {
+  LClosure *c = p->cache;
+  if (c != NULL) {  /* is there a cached closure? */
+    int nup = p->sizeupvalues;
+    Upvaldesc *uv = p->upvalues;
+    int i;
+    for (i = 0; i < nup; i++) {  /* check whether it has right upvalues */
+      if (uv[i].flat) {
+        const TValue *v = uv[i].instack ? s2v(base + uv[i].idx)
+                                        : &encup[uv[i].idx].v;
+        if (!sameflat(v, &c->upvals[i].v))
+          return NULL;  /* wrong value */
+      }
+      else {
+        TValue *v = uv[i].instack ? s2v(base + uv[i].idx)
+                                  : encup[uv[i].idx].uv->v;
+        if (c->upvals[i].uv->v != v)
+          return NULL;  /* wrong upvalue; cannot reuse closure */
+      }
+    }
+  }
+  return c;  /* return cached closure (or NULL if no cached closure) */
+}
+
+
 /*
 ** create a new ecierthon closure, push it in the stack, and initialize
-** its upvalues.
+** its upvalues. Flat upvalues get a copy of the variable's value (from
+** the stack or from the same flat upvalue of the enclosing function).
 */
-static void pushclosure (ecierthon_State *L, Proto *p, UpVal **encup, StkId base,
-                         StkId ra) {
+static void pushclosure (ecierthon_State *L, Proto *p, UpValSlot *encup,
+                         StkId base, StkId ra) {
   int nup = p->sizeupvalues;
   Upvaldesc *uv = p->upvalues;
   int i;
@@ -791,12 +888,25 @@ static void pushclosure (ecierthon_State *L, Proto *p, UpVal **encup, StkId base
   ncl->p = p;
   setclLvalue2s(L, ra, ncl);  /* anchor new closure in stack */
   for (i = 0; i < nup; i++) {  /* fill in its upvalues */
-    if (uv[i].instack)  /* upvalue refers to local variable? */
-      ncl->upvals[i] = ecierthonF_findupval(L, base + uv[i].idx);
-    else  /* get upvalue from enclosing function */
-      ncl->upvals[i] = encup[uv[i].idx];
-    ecierthonC_objbarrier(L, ncl, ncl->upvals[i]);
+    if (uv[i].flat) {  /* copy the value? */
+      if (uv[i].instack) {
+        setobj(L, &ncl->upvals[i].v, s2v(base + uv[i].idx));
+      }
+      else {
+        setobj(L, &ncl->upvals[i].v, &encup[uv[i].idx].v);
+      }
+      ecierthonC_barrier(L, ncl, &ncl->upvals[i].v);
+    }
+    else {
+      if (uv[i].instack)  /* upvalue refers to local variable? */
+        ncl->upvals[i].uv = ecierthonF_findupval(L, base + uv[i].idx);
+      else  /* get upvalue from enclosing function */
+        ncl->upvals[i].uv = encup[uv[i].idx].uv;
+      ecierthonC_objbarrier(L, ncl, ncl->upvals[i].uv);
+    }
   }
+  p->cache = ncl;  /* save it on cache for reuse */
+  ecierthonC_objbarrier(L, p, ncl);
 }
 
 
@@ -814,8 +924,8 @@ void ecierthonV_finishOp (ecierthon_State *L) {
       break;
     }
     case OP_UNM: case OP_BNOT: case OP_LEN:
-    case OP_GETTABUP: case OP_GETTABLE: case OP_GETI:
-    case OP_GETFIELD: case OP_SELF: {
+    case OP_GETTABUP: case OP_GETTABFLAT: case OP_GETTABLE: case OP_GETI:
+    case OP_GETFIELD: case OP_GETFIELD2: case OP_SELF: {
       setobjs2s(L, base + GETARG_A(inst), --L->top);
       break;
     }
@@ -847,9 +957,10 @@ void ecierthonV_finishOp (ecierthon_State *L) {
     }
     default: {
       /* only these other opcodes can yield */
-      ecierthon_assert(op == OP_TFORCALL || op == OP_CALL ||
-           op == OP_TAILCALL || op == OP_SETTABUP || op == OP_SETTABLE ||
-           op == OP_SETI || op == OP_SETFIELD);
+      ecierthon_assert(op == OP_TFORCALL || op == OP_CALL || op == OP_CALLL ||
+           op == OP_TAILCALL || op == OP_SETTABUP || op == OP_SETTABFLAT ||
+           op == OP_SETTABLE || op == OP_SETI || op == OP_SETFIELD ||
+           op == OP_SETFIELD2);
       break;
     }
   }
@@ -953,6 +1064,16 @@ void ecierthonV_finishOp (ecierthon_State *L) {
   op_arith_aux(L, v1, v2, iop, fop); }
 
 
+/*
+** Arithmetic operations over '<int>' or '<float>' values, whose types
+** are known by the compiler: no tests and no metamethods.
+*/
+#define op_typed(L,op,get,set) {  \
+  TValue *v1 = vRB(i);  \
+  TValue *v2 = vRC(i);  \
+  set(s2v(ra), op(L, get(v1), get(v2))); }
+
+
 /*
 ** Bitwise operations with constant operand.
 */
@@ -998,6 +1119,15 @@ void ecierthonV_finishOp (ecierthon_State *L) {
         docondjump(); }
 
 
+/*
+** Order operations over '<int>' or '<float>' values, whose types are
+** known by the compiler.
+*/
+#define op_ordertyped(op,get) {  \
+        int cond = op(get(s2v(ra)), get(vRB(i)));  \
+        docondjump(); }
+
+
 /*
 ** Order operations with immediate operand. (Immediate operand is
 ** always small enough to have an exact representation as a float.)
@@ -1054,8 +1184,10 @@ void ecierthonV_finishOp (ecierthon_State *L) {
 /*
 ** Execute a jump instruction. The 'updatetrap' allows signals to stop
 ** tight loops. (Without it, the local copy of 'trap' could never change.)
+** A backward jump is a safepoint.
 */
-#define dojump(ci,i,e)	{ pc += GETARG_sJ(i) + e; updatetrap(ci); }
+#define dojump(ci,i,e)	{ int sj = GETARG_sJ(i); pc += sj + e; \
+  updatetrap(ci); if (sj < 0) checksafepoint(L, pc - sj); }
 
 
 /* for test instructions, execute the jump instruction that follows it */
@@ -1097,6 +1229,24 @@ void ecierthonV_finishOp (ecierthon_State *L) {
 */
 #define halfProtect(exp)  (savestate(L,ci), (exp))
 
+/*
+** Count a safepoint against the budget of the thread (see
+** 'ecierthon_setbudget') and check for interrupts (see
+** 'ecierthon_interrupt'). Safepoints are the targets of backward jumps
+** and the entries of called ecierthon functions; nothing is half done at
+** them, so the thread can yield there. 'checksafepoint' goes after a
+** jump back, with 'from' pointing after the jump instruction;
+** 'checksafepointcall' goes after the callee's frame is ready (and
+** before 'goto startfunc', which reloads the whole state).
+*/
+#define atsafepoint(L)	(--L->budget == 0 || G(L)->interrupt)
+
+#define checksafepoint(L,from)  \
+	{ if (unlikely(atsafepoint(L))) ProtectNT(ecierthonG_safepoint(L, from)); }
+
+#define checksafepointcall(L)  \
+	{ if (unlikely(atsafepoint(L))) ecierthonG_safepoint(L, NULL); }
+
 /* 'c' is the limit of live values in the stack */
 #define checkGC(L,c)  \
 	{ ecierthonC_condGC(L, (savepc(L), L->top = (c)), \
@@ -1104,6 +1254,30 @@ void ecierthonV_finishOp (ecierthon_State *L) {
            ecierthoni_threadyield(L); }
 
 
+/*
+** Let the collector sample or pretenure the object 'o' just created by
+** the instruction at index 'pci'. (It can only raise memory errors;
+** 'top' is already correct at all uses.)
+*/
+#define allocsite(L,o,pci)  \
+	{ if (unlikely(G(L)->gcpretenure)) \
+	    (savepc(L), ecierthonC_allocsite(L, cl->p, pci, o)); }
+
+
+/*
+** Count instruction 'i' for the opcode profiler (see
+** 'ecierthon_opprofile'), both alone and as the second one of a pair.
+*/
+#if defined(ecierthonI_OPPROFILE)
+#define countop(L,i)  \
+	{ if (unlikely(G(L)->opprofiling)) { \
+	    OpProfile *p_ = G(L)->opprofile; OpCode op_ = GET_OPCODE(i); \
+	    p_->op[op_]++; p_->pair[p_->last][op_]++; p_->last = op_; } }
+#else
+#define countop(L,i)	((void)0)
+#endif
+
+
 /* fetch an instruction and prepare its execution */
 #define vmfetch()	{ \
   if (trap) {  /* stack reallocation or hooks? */ \
@@ -1111,6 +1285,7 @@ void ecierthonV_finishOp (ecierthon_State *L) {
     updatebase(ci);  /* correct stack */ \
   } \
   i = *(pc++); \
+  countop(L, i); \
   ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
 }
 
@@ -1158,6 +1333,41 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         setobjs2s(L, ra, RB(i));
         vmbreak;
       }
+      vmcase(OP_MOVE2) {
+        setobjs2s(L, ra, RB(i));
+        if (likely(!trap)) {  /* no hooks? do the next OP_MOVE too */
+          Instruction ni = *(pc++);
+          ecierthon_assert(GET_OPCODE(ni) == OP_MOVE);
+          countop(L, ni);
+          setobjs2s(L, RA(ni), RB(ni));
+        }
+        vmbreak;
+      }
+      vmcase(OP_CHECKTYPE) {
+        TValue *rb = vRB(i);
+        if (!TESTARG_k(i)) {  /* '<int>' variable? */
+          ecierthon_Integer n;
+          if (ttisinteger(rb)) {
+            setobj2s(L, ra, rb);
+          }
+          else if (ttisfloat(rb) && ecierthonV_flttointeger(fltvalue(rb), &n, F2Ieq)) {
+            setivalue(s2v(ra), n);
+          }
+          else
+            halfProtect(ecierthonG_checktypeerror(L, rb, 0));
+        }
+        else {  /* '<float>' variable */
+          if (ttisfloat(rb)) {
+            setobj2s(L, ra, rb);
+          }
+          else if (ttisinteger(rb)) {
+            setfltvalue(s2v(ra), cast_num(ivalue(rb)));
+          }
+          else
+            halfProtect(ecierthonG_checktypeerror(L, rb, 1));
+        }
+        vmbreak;
+      }
       vmcase(OP_LOADI) {
         ecierthon_Integer b = GETARG_sBx(i);
         setivalue(s2v(ra), b);
@@ -1201,18 +1411,37 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
       }
       vmcase(OP_GETUPVAL) {
         int b = GETARG_B(i);
-        setobj2s(L, ra, cl->upvals[b]->v);
+        setobj2s(L, ra, cl->upvals[b].uv->v);
         vmbreak;
       }
       vmcase(OP_SETUPVAL) {
-        UpVal *uv = cl->upvals[GETARG_B(i)];
+        UpVal *uv = cl->upvals[GETARG_B(i)].uv;
+        if (ttistable(uv->v))  /* old value may be the root of hoisted loads */
+          ecierthonH_touch(L, hvalue(uv->v));
         setobj(L, uv->v, s2v(ra));
         ecierthonC_barrier(L, uv, s2v(ra));
         vmbreak;
       }
+      vmcase(OP_GETFLAT) {
+        int b = GETARG_B(i);
+        setobj2s(L, ra, &cl->upvals[b].v);
+        vmbreak;
+      }
       vmcase(OP_GETTABUP) {
         const TValue *slot;
-        TValue *upval = cl->upvals[GETARG_B(i)]->v;
+        TValue *upval = cl->upvals[GETARG_B(i)].uv->v;
+        TValue *rc = KC(i);
+        TString *key = tsvalue(rc);  /* key must be a string */
+        if (ecierthonV_fastget(L, upval, key, slot, ecierthonH_getshortstr)) {
+          setobj2s(L, ra, slot);
+        }
+        else
+          Protect(ecierthonV_finishget(L, upval, rc, ra, slot));
+        vmbreak;
+      }
+      vmcase(OP_GETTABFLAT) {
+        const TValue *slot;
+        TValue *upval = &cl->upvals[GETARG_B(i)].v;
         TValue *rc = KC(i);
         TString *key = tsvalue(rc);  /* key must be a string */
         if (ecierthonV_fastget(L, upval, key, slot, ecierthonH_getshortstr)) {
@@ -1262,9 +1491,45 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
           Protect(ecierthonV_finishget(L, rb, rc, ra, slot));
         vmbreak;
       }
+      vmcase(OP_GETFIELD2) {
+        const TValue *slot;
+        TValue *rb = vRB(i);
+        TValue *rc = KC(i);
+        TString *key = tsvalue(rc);  /* key must be a string */
+        if (ecierthonV_fastget(L, rb, key, slot, ecierthonH_getshortstr)) {
+          setobj2s(L, ra, slot);
+        }
+        else
+          Protect(ecierthonV_finishget(L, rb, rc, ra, slot));
+        if (likely(!trap)) {  /* try the fast path of the next OP_GETFIELD */
+          Instruction ni = *pc;
+          ecierthon_assert(GET_OPCODE(ni) == OP_GETFIELD);
+          rb = vRB(ni);
+          key = tsvalue(KC(ni));
+          if (ecierthonV_fastget(L, rb, key, slot, ecierthonH_getshortstr)) {
+            countop(L, ni);
+            setobj2s(L, RA(ni), slot);
+            pc++;
+          }
+        }
+        vmbreak;
+      }
       vmcase(OP_SETTABUP) {
         const TValue *slot;
-        TValue *upval = cl->upvals[GETARG_A(i)]->v;
+        TValue *upval = cl->upvals[GETARG_A(i)].uv->v;
+        TValue *rb = KB(i);
+        TValue *rc = RKC(i);
+        TString *key = tsvalue(rb);  /* key must be a string */
+        if (ecierthonV_fastget(L, upval, key, slot, ecierthonH_getshortstr)) {
+          ecierthonV_finishfastset(L, upval, slot, rc);
+        }
+        else
+          Protect(ecierthonV_finishset(L, upval, rb, rc, slot));
+        vmbreak;
+      }
+      vmcase(OP_SETTABFLAT) {
+        const TValue *slot;
+        TValue *upval = &cl->upvals[GETARG_A(i)].v;
         TValue *rb = KB(i);
         TValue *rc = RKC(i);
         TString *key = tsvalue(rb);  /* key must be a string */
@@ -1315,6 +1580,29 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
           Protect(ecierthonV_finishset(L, s2v(ra), rb, rc, slot));
         vmbreak;
       }
+      vmcase(OP_SETFIELD2) {
+        const TValue *slot;
+        TValue *rb = KB(i);
+        TValue *rc = RKC(i);
+        TString *key = tsvalue(rb);  /* key must be a string */
+        if (ecierthonV_fastget(L, s2v(ra), key, slot, ecierthonH_getshortstr)) {
+          ecierthonV_finishfastset(L, s2v(ra), slot, rc);
+        }
+        else
+          Protect(ecierthonV_finishset(L, s2v(ra), rb, rc, slot));
+        if (likely(!trap)) {  /* try the fast path of the next OP_SETFIELD */
+          Instruction ni = *pc;
+          ecierthon_assert(GET_OPCODE(ni) == OP_SETFIELD);
+          ra = RA(ni);
+          key = tsvalue(KB(ni));
+          if (ecierthonV_fastget(L, s2v(ra), key, slot, ecierthonH_getshortstr)) {
+            countop(L, ni);
+            ecierthonV_finishfastset(L, s2v(ra), slot, RKC(ni));
+            pc++;
+          }
+        }
+        vmbreak;
+      }
       vmcase(OP_NEWTABLE) {
         int b = GETARG_B(i);  /* log2(hash size) + 1 */
         int c = GETARG_C(i);  /* array size */
@@ -1330,6 +1618,17 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         sethvalue2s(L, ra, t);
         if (b != 0 || c != 0)
           ecierthonH_resize(L, t, c, b);  /* idem */
+        allocsite(L, s2v(ra), pcRel(pc, cl->p) - 1);  /* skip extra arg. */
+        checkGC(L, ra + 1);
+        vmbreak;
+      }
+      vmcase(OP_NEWTABLEK) {
+        Table *t;
+        L->top = ra + 1;  /* correct top in case of emergency GC */
+        t = ecierthonH_new(L);  /* memory allocation */
+        sethvalue2s(L, ra, t);
+        ecierthonH_copy(L, t, hvalue(&k[GETARG_Bx(i)]));  /* idem */
+        allocsite(L, s2v(ra), pcRel(pc, cl->p));
         checkGC(L, ra + 1);
         vmbreak;
       }
@@ -1456,6 +1755,34 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         op_bitwise(L, ecierthonV_shiftl);
         vmbreak;
       }
+      vmcase(OP_ADDII) {
+        op_typed(L, l_addi, ivalue, setivalue);
+        vmbreak;
+      }
+      vmcase(OP_SUBII) {
+        op_typed(L, l_subi, ivalue, setivalue);
+        vmbreak;
+      }
+      vmcase(OP_MULII) {
+        op_typed(L, l_muli, ivalue, setivalue);
+        vmbreak;
+      }
+      vmcase(OP_ADDFF) {
+        op_typed(L, ecierthoni_numadd, fltvalue, setfltvalue);
+        vmbreak;
+      }
+      vmcase(OP_SUBFF) {
+        op_typed(L, ecierthoni_numsub, fltvalue, setfltvalue);
+        vmbreak;
+      }
+      vmcase(OP_MULFF) {
+        op_typed(L, ecierthoni_nummul, fltvalue, setfltvalue);
+        vmbreak;
+      }
+      vmcase(OP_DIVFF) {
+        op_typed(L, ecierthoni_numdiv, fltvalue, setfltvalue);
+        vmbreak;
+      }
       vmcase(OP_MMBIN) {
         Instruction pi = *(pc - 2);  /* original arith. expression */
         TValue *rb = vRB(i);
@@ -1523,6 +1850,7 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         int n = GETARG_B(i);  /* number of elements to concatenate */
         L->top = ra + n;  /* mark the end of concat operands */
         ProtectNT(ecierthonV_concat(L, n));
+        allocsite(L, s2v(L->top - 1), pcRel(pc, cl->p));
         checkGC(L, L->top); /* 'ecierthonV_concat' ensures correct top */
         vmbreak;
       }
@@ -1539,6 +1867,14 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         dojump(ci, i, 0);
         vmbreak;
       }
+      vmcase(OP_SWITCH) {
+        const TValue *v = ecierthonH_get(hvalue(&k[GETARG_Bx(i)]), s2v(ra));
+        if (!isempty(v)) {  /* is there a case for this value? */
+          pc += ivalue(v);  /* jump to it */
+          updatetrap(ci);
+        }
+        vmbreak;
+      }
       vmcase(OP_EQ) {
         int cond;
         TValue *rb = vRB(i);
@@ -1589,6 +1925,22 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         op_orderI(L, l_gei, ecierthoni_numge, 1, TM_LE);
         vmbreak;
       }
+      vmcase(OP_LTII) {
+        op_ordertyped(l_lti, ivalue);
+        vmbreak;
+      }
+      vmcase(OP_LEII) {
+        op_ordertyped(l_lei, ivalue);
+        vmbreak;
+      }
+      vmcase(OP_LTFF) {
+        op_ordertyped(ecierthoni_numlt, fltvalue);
+        vmbreak;
+      }
+      vmcase(OP_LEFF) {
+        op_ordertyped(ecierthoni_numle, fltvalue);
+        vmbreak;
+      }
       vmcase(OP_TEST) {
         int cond = !l_isfalse(s2v(ra));
         docondjump();
@@ -1606,21 +1958,64 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
       }
       vmcase(OP_CALL) {
         CallInfo *newci;
-        int b = GETARG_B(i);
-        int nresults = GETARG_C(i) - 1;
+        int b, nresults;
+       genericcall:
+        b = GETARG_B(i);
+        nresults = GETARG_C(i) - 1;
         if (b != 0)  /* fixed number of arguments? */
           L->top = ra + b;  /* top signals number of arguments */
         /* else previous instruction set top */
         savepc(L);  /* in case of errors */
-        if ((newci = ecierthonD_precall(L, ra, nresults)) == NULL)
+        if ((newci = ecierthonD_precall(L, ra, nresults)) == NULL) {
+          if (unlikely(L->status == ecierthon_YIELD))
+            return;  /* C function yielded; back to 'resume' */
           updatetrap(ci);  /* C call; nothing else to be done */
+        }
         else {  /* ecierthon call: run function in this same C frame */
+          Proto *np = clLvalue(s2v(newci->func))->p;
+          if (!TESTARG_k(i) && np->numparams == b - 1 && !np->is_vararg &&
+              cl->p->shared == NULL)  /* can specialize this call site? */
+            SET_OPCODE(*cast(Instruction *, pc - 1), OP_CALLL);
           ci = newci;
           ci->callstatus = 0;  /* call re-uses 'ecierthonV_execute' */
+          checksafepointcall(L);
           goto startfunc;
         }
         vmbreak;
       }
+      vmcase(OP_CALLL) {
+        TValue *fv = s2v(ra);
+        int b = GETARG_B(i);
+        Proto *np;
+        if (likely(ttisLclosure(fv) &&
+                   (np = clLvalue(fv)->p)->numparams == b - 1 &&
+                   !np->is_vararg)) {  /* same kind of callee? */
+          CallInfo *newci;
+          int fsize = np->maxstacksize;
+          L->top = ra + b;
+          savepc(L);  /* in case of errors */
+          checkstackGCp(L, fsize, ra);
+          newci = next_ci(L);
+          newci->nresults = GETARG_C(i) - 1;
+          newci->u.l.savedpc = np->code;
+          newci->top = ra + 1 + fsize;
+          newci->func = ra;
+          newci->callstatus = 0;
+          ecierthon_assert(newci->top <= L->stack_last);
+          L->ci = ci = newci;
+          checksafepointcall(L);
+          goto startfunc;
+        }
+        else if (cl->p->shared == NULL) {  /* give up specializing */
+          Instruction *ip = cast(Instruction *, pc - 1);
+          SET_OPCODE(*ip, OP_CALL);
+          SETARG_k(*ip, 1);
+          pc--;  /* execute it again, as a generic call */
+          vmbreak;
+        }
+        else  /* shared code is read-only */
+          goto genericcall;
+      }
       vmcase(OP_TAILCALL) {
         int b = GETARG_B(i);  /* number of arguments + 1 (function) */
         int nparams1 = GETARG_C(i);
@@ -1645,6 +2040,8 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         }
         if (!ttisLclosure(s2v(ra))) {  /* C function? */
           ecierthonD_precall(L, ra, ecierthon_MULTRET);  /* call it */
+          if (unlikely(L->status == ecierthon_YIELD))
+            return;  /* C function yielded; back to 'resume' */
           updatetrap(ci);
           updatestack(ci);  /* stack may have been relocated */
           ci->func -= delta;  /* restore 'func' (if vararg) */
@@ -1654,6 +2051,7 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         }
         ci->func -= delta;  /* restore 'func' (if vararg) */
         ecierthonD_pretailcall(L, ci, ra, b);  /* prepare call frame */
+        checksafepointcall(L);
         goto startfunc;  /* execute the callee */
       }
       vmcase(OP_RETURN) {
@@ -1730,10 +2128,13 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
             chgivalue(s2v(ra), idx);  /* update internal index */
             setivalue(s2v(ra + 3), idx);  /* and control variable */
             pc -= GETARG_Bx(i);  /* jump back */
+            checksafepoint(L, pc + GETARG_Bx(i));
           }
         }
-        else if (floatforloop(ra))  /* float loop */
+        else if (floatforloop(ra)) {  /* float loop */
           pc -= GETARG_Bx(i);  /* jump back */
+          checksafepoint(L, pc + GETARG_Bx(i));
+        }
         updatetrap(ci);  /* allows a signal to break the loop */
         vmbreak;
       }
@@ -1743,6 +2144,48 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
           pc += GETARG_Bx(i) + 1;  /* skip the loop */
         vmbreak;
       }
+      vmcase(OP_FORPREPH) {
+        savestate(L, ci);  /* in case of errors */
+        if (forprep(L, ra))
+          pc += GETARG_Bx(i) + 1;  /* skip the loop */
+        else {
+          if (unlikely(cl->p->hoist == NULL))
+            Protect(createhoist(L, cl->p));
+          pc += GETARG_Bx(i) + 2;  /* load hoisted values first */
+        }
+        vmbreak;
+      }
+      vmcase(OP_HOISTUP) {
+        Proto *p = cl->p;
+        hoistget(L, p, &p->hoist[GETARG_A(i)], cl->upvals[GETARG_B(i)].uv->v,
+                 tsvalue(KC(i)));
+        vmbreak;
+      }
+      vmcase(OP_HOISTFIELD) {
+        Proto *p = cl->p;
+        hoistget(L, p, &p->hoist[GETARG_A(i)], &p->hoist[GETARG_B(i)],
+                 tsvalue(KC(i)));
+        vmbreak;
+      }
+      vmcase(OP_HOISTDONE) {
+        TValue *stamp = &cl->p->hoist[GETARG_A(i)];
+        setivalue(stamp, l_castU2S(G(L)->hoistepoch));
+        setpvalue(stamp + 1, cl);  /* closure that computed the values */
+        pc -= GETARG_Bx(i);
+        vmbreak;
+      }
+      vmcase(OP_GETHOIST) {
+        TValue *stamp = &cl->p->hoist[GETARG_A(i)];
+        TValue *v = &cl->p->hoist[GETARG_B(i)];
+        if (ttisinteger(stamp) &&
+            l_castS2U(ivalue(stamp)) == G(L)->hoistepoch &&
+            pvalue(stamp + 1) == cl && !ttisnil(v)) {
+          int n = GETARG_C(i);  /* number of ordinary instructions */
+          setobj2s(L, base + GETARG_A(*(pc + n - 1)), v);
+          pc += n;  /* skip them */
+        }
+        vmbreak;
+      }
       vmcase(OP_TFORPREP) {
         /* create to-be-closed upvalue (if needed) */
         halfProtect(ecierthonF_newtbcupval(L, ra + 3));
@@ -1765,6 +2208,7 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         updatestack(ci);  /* stack may have changed */
         i = *(pc++);  /* go to next instruction */
         ecierthon_assert(GET_OPCODE(i) == OP_TFORLOOP && ra == RA(i));
+        countop(L, i);
         goto l_tforloop;
       }
       vmcase(OP_TFORLOOP) {
@@ -1772,6 +2216,7 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         if (!ttisnil(s2v(ra + 4))) {  /* continue loop? */
           setobjs2s(L, ra + 2, ra + 4);  /* save control variable */
           pc -= GETARG_Bx(i);  /* jump back */
+          checksafepoint(L, pc + GETARG_Bx(i));
         }
         vmbreak;
       }
@@ -1800,7 +2245,13 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
       }
       vmcase(OP_CLOSURE) {
         Proto *p = cl->p->p[GETARG_Bx(i)];
+        LClosure *ncl = getcached(p, cl->upvals, base);  /* cached closure */
+        if (ncl != NULL) {  /* match? */
+          setclLvalue2s(L, ra, ncl);  /* push cached closure */
+          vmbreak;
+        }
         halfProtect(pushclosure(L, p, cl->upvals, base, ra));
+        allocsite(L, s2v(ra), pcRel(pc, cl->p));
         checkGC(L, ra + 1);
         vmbreak;
       }
@@ -1809,6 +2260,18 @@ void ecierthonV_execute (ecierthon_State *L, CallInfo *ci) {
         Protect(ecierthonT_getvarargs(L, ci, ra, n));
         vmbreak;
       }
+      vmcase(OP_SELECT) {
+        TValue *fv = s2v(ra);
+        if (ttislcf(fv) && fvalue(fv) == G(L)->selectf) {
+          Instruction call = *(pc + 1);  /* instruction after OP_VARARG */
+          int n = (GET_OPCODE(call) == OP_TAILCALL) ? -1 : GETARG_C(call) - 1;
+          int done;
+          Protect(done = ecierthonT_selectvarargs(L, ci, ra, s2v(ra + 1), n));
+          if (done)
+            pc += 2;  /* skip OP_VARARG and the call */
+        }
+        vmbreak;
+      }
       vmcase(OP_VARARGPREP) {
         ProtectNT(ecierthonT_adjustvarargs(L, GETARG_A(i), ci, cl->p));
         if (trap) {
@@ -105,6 +105,7 @@ typedef enum {
 */
 #define ecierthonV_finishfastset(L,t,slot,v) \
     { setobj2t(L, cast(TValue *,slot), v); \
+      ecierthonH_touch(L, hvalue(t)); \
       ecierthonC_barrierback(L, gcvalue(t), v); }
 
 